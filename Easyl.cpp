@@ -1,6 +1,7 @@
 #include <maya\MFnPlugin.h>
 #include <maya\MGlobal.h>
 #include "paintContextCmd.h"
+#include "paintCurveCmd.h"
 
 //////////////////////////////////////////////
 // plugin initialization
@@ -18,7 +19,7 @@ MStatus initializePlugin(MObject obj)
 	MGlobal::executeCommand("putenv \"MAYA_SCRIPT_PATH\" $compat;");
 
 	status = plugin.registerContextCommand("paintContext",
-		paintContextCmd::creator);
+		paintContextCmd::creator, "paintCurve", paintCurveCmd::creator);
 	status = plugin.registerUI("EasylUICreator", "EasylUIDestroyer");
 
 	return status;
@@ -29,7 +30,7 @@ MStatus uninitializePlugin(MObject obj)
 	MStatus		status;
 	MFnPlugin	plugin(obj);
 
-	status = plugin.deregisterContextCommand("paintContext");
+	status = plugin.deregisterContextCommand("paintContext", "paintCurve");
 
 	return status;
 }
@@ -0,0 +1,39 @@
+#include "bandedMatrix.h"
+#include <algorithm>
+
+void BandedMatrix::resize(int size, int bandwidth) {
+	n = size;
+	k = bandwidth;
+	bands.assign((size_t)(k + 1) * n, 0.0);
+}
+
+void BandedMatrix::setZero() {
+	std::fill(bands.begin(), bands.end(), 0.0);
+}
+
+bool BandedMatrix::solve(std::vector<double>& rhs) {
+	//factor A = L D L^T, L unit lower triangular with the same bandwidth
+	for (int j = 0; j < n; j++) {
+		double d = at(j, j);
+		for (int m = std::max(0, j - k); m < j; m++) {
+			double l = at(j, m);
+			d -= l * l * at(m, m);
+		}
+		if (!(d > 0)) return false;
+		at(j, j) = d;
+
+		for (int i = j + 1; i <= std::min(n - 1, j + k); i++) {
+			double v = at(i, j);
+			for (int m = std::max(0, i - k); m < j; m++) v -= at(i, m) * at(j, m) * at(m, m);
+			at(i, j) = v / d;
+		}
+	}
+
+	//forward substitution with L, scale by D, back substitution with L^T
+	for (int i = 0; i < n; i++)
+		for (int m = std::max(0, i - k); m < i; m++) rhs[i] -= at(i, m) * rhs[m];
+	for (int i = 0; i < n; i++) rhs[i] /= at(i, i);
+	for (int i = n - 1; i >= 0; i--)
+		for (int m = i + 1; m <= std::min(n - 1, i + k); m++) rhs[i] -= at(m, i) * rhs[m];
+	return true;
+}
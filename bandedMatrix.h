@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+
+//Symmetric positive definite matrix with a fixed half bandwidth, stored as its lower bands.
+//Entry (i, j) is only stored for |i - j| <= bandwidth; everything else is zero.
+class BandedMatrix {
+public:
+	BandedMatrix() : n(0), k(0) {}
+	BandedMatrix(int size, int bandwidth) { resize(size, bandwidth); }
+
+	void resize(int size, int bandwidth);
+	void setZero();
+	int size() const { return n; }
+	int bandwidth() const { return k; }
+
+	//element access for |i - j| <= bandwidth, either triangle
+	double& at(int i, int j) { return i >= j ? bands[(i - j) * n + j] : bands[(j - i) * n + i]; }
+	double at(int i, int j) const { return i >= j ? bands[(i - j) * n + j] : bands[(j - i) * n + i]; }
+
+	//in place Cholesky (LDL^T) factorization then solve for rhs; O(n k^2).
+	//Returns false and leaves the matrix garbage if it is not positive definite.
+	bool solve(std::vector<double>& rhs);
+
+private:
+	int n, k;
+	std::vector<double> bands; //band d holds entries (j + d, j), so the diagonal is band 0
+};
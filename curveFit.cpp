@@ -0,0 +1,208 @@
+#include "curveFit.h"
+#include "bandedMatrix.h"
+#include <algorithm>
+
+const int kDegree = 3;
+//parameter corrections (points pulled to their closest curve parameter) per fit
+const int kReparameterizeSteps = 2;
+//keeps spans without points solvable; relative to the squared stroke length
+const double kSmoothing = 1e-8;
+//refinement rounds; each can double the span count
+const int kMaxRounds = 12;
+
+//Span of the full (clamped, with end knots repeated degree + 1 times) knot vector U holding u.
+//Spans are [U[s], U[s+1]) with s in [degree, cvs - 1]
+static int findSpan(const std::vector<double>& U, int cvCount, double u) {
+	if (u >= U[cvCount]) return cvCount - 1;
+	int s = (int)(std::upper_bound(U.begin() + kDegree, U.begin() + cvCount + 1, u) - U.begin()) - 1;
+	return std::max(kDegree, s);
+}
+
+//The degree + 1 basis functions that are non zero at u in span s, and their derivatives
+//(The NURBS Book, A2.2 and A2.3 for the first derivative)
+static void basis(const std::vector<double>& U, int s, double u, double* N, double* dN) {
+	double left[kDegree + 1], right[kDegree + 1];
+	double lower[kDegree]; //degree - 1 functions, kept for the derivative
+	N[0] = 1;
+	for (int j = 1; j <= kDegree; j++) {
+		left[j] = u - U[s + 1 - j];
+		right[j] = U[s + j] - u;
+		if (j == kDegree) for (int r = 0; r < kDegree; r++) lower[r] = N[r];
+		double saved = 0;
+		for (int r = 0; r < j; r++) {
+			double denom = right[r + 1] + left[j - r];
+			double temp = denom > 0 ? N[r] / denom : 0;
+			N[r] = saved + right[r + 1] * temp;
+			saved = left[j - r] * temp;
+		}
+		N[j] = saved;
+	}
+	if (!dN) return;
+	for (int r = 0; r <= kDegree; r++) {
+		double d = 0;
+		if (r > 0) {
+			double denom = U[s + r] - U[s + r - kDegree];
+			if (denom > 0) d += lower[r - 1] / denom;
+		}
+		if (r < kDegree) {
+			double denom = U[s + r + 1] - U[s + r + 1 - kDegree];
+			if (denom > 0) d -= lower[r] / denom;
+		}
+		dN[r] = kDegree * d;
+	}
+}
+
+static Vec3 evaluate(const std::vector<double>& U, const std::vector<Vec3>& cvs, double u, Vec3* derivative) {
+	int m = (int)cvs.size();
+	int s = findSpan(U, m, u);
+	double N[kDegree + 1], dN[kDegree + 1];
+	basis(U, s, u, N, derivative ? dN : 0);
+	Vec3 p;
+	if (derivative) *derivative = Vec3();
+	for (int r = 0; r <= kDegree; r++) {
+		p += cvs[s - kDegree + r] * N[r];
+		if (derivative) *derivative += cvs[s - kDegree + r] * dN[r];
+	}
+	return p;
+}
+
+//Solves for the interior cvs of the curve on knot vector U given each point's parameter.
+//The normal equations of a cubic are banded with half bandwidth 3.
+static void solveCVs(const std::vector<Vec3>& points, const std::vector<double>& params,
+	const std::vector<double>& U, double smoothing, std::vector<Vec3>& cvs) {
+	int m = (int)U.size() - kDegree - 1;
+	int n = (int)points.size();
+	cvs.assign(m, Vec3());
+	cvs[0] = points[0];
+	cvs[m - 1] = points[n - 1];
+	int unknowns = m - 2;
+	if (unknowns <= 0) return;
+
+	//unknown j is cv j + 1
+	BandedMatrix A(unknowns, kDegree);
+	std::vector<Vec3> rhs(unknowns);
+	double N[kDegree + 1];
+	for (int i = 0; i < n; i++) {
+		int s = findSpan(U, m, params[i]);
+		basis(U, s, params[i], N, 0);
+		//move the pinned ends to the right hand side
+		Vec3 target = points[i];
+		for (int r = 0; r <= kDegree; r++) {
+			int cv = s - kDegree + r;
+			if (cv == 0 || cv == m - 1) target -= cvs[cv] * N[r];
+		}
+		for (int r = 0; r <= kDegree; r++) {
+			int a = s - kDegree + r - 1;
+			if (a < 0 || a >= unknowns) continue;
+			rhs[a] += target * N[r];
+			for (int q = 0; q <= r; q++) {
+				int b = s - kDegree + q - 1;
+				if (b >= 0) A.at(a, b) += N[r] * N[q];
+			}
+		}
+	}
+
+	//a little second difference smoothing over all cvs, so empty spans stay well posed
+	for (int j = 1; j + 1 < m; j++) {
+		int idx[3] = { j - 2, j - 1, j };
+		double w[3] = { 1, -2, 1 };
+		for (int r = 0; r < 3; r++) {
+			if (idx[r] < 0 || idx[r] >= unknowns) continue;
+			for (int q = 0; q < 3; q++) {
+				if (idx[q] >= 0 && idx[q] < unknowns) {
+					if (idx[q] <= idx[r]) A.at(idx[r], idx[q]) += smoothing * w[r] * w[q];
+				} else {
+					//pinned end: its share goes to the right hand side
+					rhs[idx[r]] -= cvs[idx[q] + 1] * (smoothing * w[r] * w[q]);
+				}
+			}
+		}
+	}
+
+	//one factorization per axis; the matrix is small next to the point count
+	for (int axis = 0; axis < 3; axis++) {
+		BandedMatrix factor = A;
+		std::vector<double> b(unknowns);
+		for (int j = 0; j < unknowns; j++) b[j] = rhs[j][axis];
+		if (!factor.solve(b)) return;
+		for (int j = 0; j < unknowns; j++) cvs[j + 1][axis] = b[j];
+	}
+}
+
+//Full knot vector (end knots repeated degree + 1 times) from the interior breaks
+static void fullKnots(const std::vector<double>& breaks, std::vector<double>& U) {
+	U.assign(kDegree + 1, 0.0);
+	U.insert(U.end(), breaks.begin(), breaks.end());
+	U.insert(U.end(), kDegree + 1, 1.0);
+}
+
+void fitCubic(const std::vector<Vec3>& points, double tolerance, CurveFit& fit) {
+	int n = (int)points.size();
+	fit.cvs.clear();
+	fit.knots.clear();
+	fit.maxError = 0;
+	if (n < kDegree + 1) {
+		fit.degree = 1;
+		fit.cvs = points;
+		for (int i = 0; i < n; i++) fit.knots.push_back(i);
+		return;
+	}
+	fit.degree = kDegree;
+
+	//chord length parameters
+	std::vector<double> params(n, 0.0);
+	for (int i = 1; i < n; i++) params[i] = params[i - 1] + length(points[i] - points[i - 1]);
+	double total = params[n - 1];
+	if (total <= 0) total = 1;
+	for (int i = 1; i < n; i++) params[i] /= total;
+	params[n - 1] = 1;
+	double smoothing = kSmoothing * total * total;
+
+	std::vector<double> breaks, U;
+	std::vector<Vec3> cvs;
+	std::vector<double> errors(n);
+	for (int round = 0; round <= kMaxRounds; round++) {
+		fullKnots(breaks, U);
+		int m = (int)U.size() - kDegree - 1;
+
+		//fit, then pull every parameter to the closest point on the curve and fit again
+		for (int step = 0; ; step++) {
+			solveCVs(points, params, U, smoothing, cvs);
+			if (step == kReparameterizeSteps) break;
+			for (int i = 1; i < n - 1; i++) {
+				Vec3 d1;
+				Vec3 offset = evaluate(U, cvs, params[i], &d1) - points[i];
+				double d2 = length2(d1);
+				if (d2 > 0) params[i] = std::min(1.0, std::max(0.0, params[i] - dot(offset, d1) / d2));
+			}
+		}
+
+		fit.maxError = 0;
+		for (int i = 0; i < n; i++) {
+			errors[i] = length(evaluate(U, cvs, params[i], 0) - points[i]);
+			fit.maxError = std::max(fit.maxError, errors[i]);
+		}
+		if (fit.maxError <= tolerance || round == kMaxRounds) break;
+
+		//halve every span holding a point that is out of tolerance, as long as it holds enough
+		//points to pin down the extra cv
+		std::vector<int> spanPoints(m, 0);
+		std::vector<char> split(m, 0);
+		for (int i = 0; i < n; i++) {
+			int s = findSpan(U, m, params[i]);
+			spanPoints[s]++;
+			if (errors[i] > tolerance) split[s] = 1;
+		}
+		std::vector<double> next;
+		for (int s = kDegree; s < m; s++) {
+			if (s > kDegree) next.push_back(U[s]);
+			if (split[s] && spanPoints[s] >= 2) next.push_back(0.5 * (U[s] + U[s + 1]));
+		}
+		if (next.size() == breaks.size()) break;
+		breaks.swap(next);
+	}
+
+	//Maya drops the outermost end knots
+	fit.cvs = cvs;
+	fit.knots.assign(U.begin() + 1, U.end() - 1);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <vector>
+#include "vec3.h"
+
+//Clamped cubic B-spline fitted to a polyline. knots uses Maya's convention of
+//cvs + degree - 1 entries (no phantom end knots).
+struct CurveFit {
+	int degree;
+	std::vector<Vec3> cvs;
+	std::vector<double> knots;
+	//largest distance from an input point to the curve at that point's parameter
+	double maxError;
+
+	CurveFit() : degree(3), maxError(0) {}
+};
+
+//Least squares cubic through points, with both ends pinned to the first and last point.
+//Starts from a single span and halves every span whose points are further than tolerance
+//from the curve until all are within it (or every span holds too few points to split).
+//Fewer than 4 points come back as a degree 1 curve through them.
+void fitCubic(const std::vector<Vec3>& points, double tolerance, CurveFit& fit);
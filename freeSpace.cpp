@@ -0,0 +1,70 @@
+#include "freeSpace.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+void FreeSpace::clear() {
+	cx.clear(); cy.clear(); cz.clear();
+	radius.clear();
+}
+
+void FreeSpace::add(const Vec3& centre, double distance) {
+	if (!(distance > 0)) return;
+	cx.push_back(centre.x); cy.push_back(centre.y); cz.push_back(centre.z);
+	radius.push_back(distance);
+}
+
+void FreeSpace::append(const FreeSpace& other) {
+	cx.insert(cx.end(), other.cx.begin(), other.cx.end());
+	cy.insert(cy.end(), other.cy.begin(), other.cy.end());
+	cz.insert(cz.end(), other.cz.begin(), other.cz.end());
+	radius.insert(radius.end(), other.radius.begin(), other.radius.end());
+}
+
+double FreeSpace::reach(const Vec3& origin, const Vec3& direction, double start, double level,
+	FreeSpace* used) const {
+	double dd = dot(direction, direction);
+	if (!(dd > 0)) return start;
+
+	//the stretch of the ray inside each shrunk ball, as t intervals
+	std::vector<std::pair<double, int> > spans;
+	std::vector<double> exits(radius.size());
+	for (int k = 0; k < (int)radius.size(); k++) {
+		double r = radius[k] - level;
+		if (r <= 0) continue;
+		Vec3 oc(origin.x - cx[k], origin.y - cy[k], origin.z - cz[k]);
+		double b = dot(oc, direction) / dd;
+		double disc = b * b - (dot(oc, oc) - r * r) / dd;
+		if (disc <= 0) continue;
+		double s = std::sqrt(disc);
+		exits[k] = -b + s;
+		if (exits[k] <= start) continue;
+		spans.push_back(std::make_pair(-b - s, k));
+	}
+	std::sort(spans.begin(), spans.end());
+
+	//chain overlapping intervals from start outward
+	double t = start;
+	for (size_t s = 0; s < spans.size() && spans[s].first < t; s++) {
+		int k = spans[s].second;
+		if (exits[k] <= t) continue;
+		t = exits[k];
+		if (used) used->add(Vec3(cx[k], cy[k], cz[k]), radius[k]);
+	}
+	return t;
+}
+
+void DepthCache::record(const std::shared_ptr<const SceneBVH>& scene, const FreeSpace& trace) {
+	if (!scene || trace.empty()) return;
+	if (measured.lock() != scene) {
+		strokes.clear();
+		measured = scene;
+	}
+	strokes.push_back(trace);
+	if ((int)strokes.size() > kCachedStrokes) strokes.pop_front();
+}
+
+void DepthCache::gather(const std::shared_ptr<const SceneBVH>& scene, FreeSpace& out) const {
+	if (!scene || measured.lock() != scene) return;
+	for (size_t s = 0; s < strokes.size(); s++) out.append(strokes[s]);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include "vec3.h"
+#include "sceneBVH.h"
+
+//Balls known to hold no surface. Every sample of a ray's sphere trace measures the distance
+//to the mesh, so the ball of that radius around it is empty and a later ray passing through
+//it can skip its inside without losing the first crossing. Maya-free; stored as
+//structure-of-arrays like the stroke's rays.
+class FreeSpace {
+public:
+	void clear();
+	bool empty() const { return radius.empty(); }
+	int size() const { return (int)radius.size(); }
+
+	//centre is a sample point and distance the unsigned distance measured there
+	void add(const Vec3& centre, double distance);
+	void append(const FreeSpace& other);
+
+	//farthest t reached from start along origin + t*direction while staying more than level
+	//from the mesh, i.e. inside balls shrunk by level. Returns start if start isn't covered.
+	//The balls the path went through are added to used, so the next ray can start from them.
+	double reach(const Vec3& origin, const Vec3& direction, double start, double level,
+		FreeSpace* used = 0) const;
+
+private:
+	std::vector<double> cx, cy, cz;
+	std::vector<double> radius;
+};
+
+//Free space left by the first rays of recent strokes, so the first ray of a new stroke can
+//start where an earlier one already proved the view empty. Strokes over other parts of the
+//scene simply don't cover the new ray. Tied to the scene it was measured on.
+class DepthCache {
+public:
+	void record(const std::shared_ptr<const SceneBVH>& scene, const FreeSpace& trace);
+	//every remembered ball, or nothing if the scene has changed since
+	void gather(const std::shared_ptr<const SceneBVH>& scene, FreeSpace& out) const;
+	void clear() { strokes.clear(); }
+
+	//strokes remembered
+	static const int kCachedStrokes = 8;
+
+private:
+	std::weak_ptr<const SceneBVH> measured;
+	std::deque<FreeSpace> strokes;
+};
@@ -0,0 +1,337 @@
+#include "furInterpolator.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+const int kDefaultPointsPerStrand = 16;
+//children blended per task
+const int kBlendGrain = 64;
+
+FurInterpolator::FurInterpolator() {
+	perStrand = kDefaultPointsPerStrand;
+	children = 0;
+	radiusUsed = 0;
+}
+
+void FurInterpolator::setPointsPerStrand(int points) {
+	perStrand = std::max(2, points);
+}
+
+void FurInterpolator::keepGuides(const std::vector<char>& keep) {
+	size_t kept = 0;
+	for (size_t g = 0; g < guides.size() && g < keep.size(); g++) {
+		if (!keep[g]) continue;
+		if (kept != g) guides[kept].swap(guides[g]);
+		kept++;
+	}
+	guides.resize(kept);
+}
+
+void FurInterpolator::clearGuides() {
+	guides.clear();
+}
+
+//resampled by arc length so every guide has perStrand points, root first
+bool FurInterpolator::addGuide(const std::vector<Vec3>& points) {
+	if (points.size() < 2) return false;
+	std::vector<double> along(points.size(), 0.0);
+	for (size_t i = 1; i < points.size(); i++) along[i] = along[i - 1] + length(points[i] - points[i - 1]);
+	if (!(along.back() > 0)) return false;
+
+	std::vector<Vec3> resampled(perStrand);
+	size_t segment = 1;
+	for (int j = 0; j < perStrand; j++) {
+		double s = along.back() * j / (perStrand - 1);
+		while (segment < points.size() - 1 && along[segment] < s) segment++;
+		double span = along[segment] - along[segment - 1];
+		double f = span > 0 ? (s - along[segment - 1]) / span : 0;
+		resampled[j] = points[segment - 1] + (points[segment] - points[segment - 1]) * f;
+	}
+	guides.push_back(resampled);
+	return true;
+}
+
+//21 bits per axis, biased so negative cells pack too (as in SparseSDF)
+static long long cellKey(int i, int j, int k) {
+	const long long bias = 1 << 20;
+	return ((i + bias) << 42) | ((j + bias) << 21) | (k + bias);
+}
+
+void FurInterpolator::GuideGrid::build(const std::vector<Vec3>& points, double cellSize) {
+	cell = cellSize;
+	int n = (int)points.size();
+	std::vector<std::pair<long long, int> > sorted(n);
+	for (int g = 0; g < n; g++) {
+		const Vec3& p = points[g];
+		sorted[g] = std::make_pair(cellKey((int)std::floor(p.x / cell), (int)std::floor(p.y / cell),
+			(int)std::floor(p.z / cell)), g);
+	}
+	std::sort(sorted.begin(), sorted.end());
+	keys.resize(n);
+	guides.resize(n);
+	for (int g = 0; g < n; g++) {
+		keys[g] = sorted[g].first;
+		guides[g] = sorted[g].second;
+	}
+}
+
+//cells are as wide as the radius, so the 27 around p hold everything in reach
+int FurInterpolator::GuideGrid::nearest(const std::vector<Vec3>& points, const Vec3& p, double radius,
+	int* found, double* dist2) const {
+	int count = 0;
+	double r2 = radius * radius;
+	int ci = (int)std::floor(p.x / cell), cj = (int)std::floor(p.y / cell), ck = (int)std::floor(p.z / cell);
+	for (int i = ci - 1; i <= ci + 1; i++)
+		for (int j = cj - 1; j <= cj + 1; j++)
+			for (int k = ck - 1; k <= ck + 1; k++) {
+				long long key = cellKey(i, j, k);
+				std::vector<long long>::const_iterator it = std::lower_bound(keys.begin(), keys.end(), key);
+				for (size_t s = it - keys.begin(); s < keys.size() && keys[s] == key; s++) {
+					int g = guides[s];
+					double d2 = length2(points[g] - p);
+					if (d2 > r2) continue;
+					//insertion into the short sorted list, dropping the farthest when full
+					int at = count < kMaxBlend ? count++ : kMaxBlend;
+					if (at == kMaxBlend && d2 >= dist2[kMaxBlend - 1]) continue;
+					if (at == kMaxBlend) at--;
+					while (at > 0 && dist2[at - 1] > d2) {
+						found[at] = found[at - 1];
+						dist2[at] = dist2[at - 1];
+						at--;
+					}
+					found[at] = g;
+					dist2[at] = d2;
+				}
+			}
+	return count;
+}
+
+//anchors each guide to the surface under its root and stores its shape relative to the root
+void FurInterpolator::prepareGuides(const SceneBVH& scene) {
+	int n = guideCount();
+	anchors.resize(n);
+	normals.resize(n);
+	heights.resize(n);
+	gx.resize((size_t)n * perStrand);
+	gy.resize((size_t)n * perStrand);
+	gz.resize((size_t)n * perStrand);
+	for (int g = 0; g < n; g++) {
+		const std::vector<Vec3>& points = guides[g];
+		SceneHit hit;
+		Vec3 normal(0, 0, 1);
+		if (scene.closestPoint(points[0], hit)) normal = normalize(scene.pseudoNormal(hit));
+		anchors[g] = hit.mesh < 0 ? points[0] : hit.hit.point;
+		normals[g] = normal;
+		heights[g] = (float)dot(points[0] - anchors[g], normal);
+		for (int j = 0; j < perStrand; j++) {
+			Vec3 offset = points[j] - points[0];
+			gx[(size_t)g * perStrand + j] = (float)offset.x;
+			gy[(size_t)g * perStrand + j] = (float)offset.y;
+			gz[(size_t)g * perStrand + j] = (float)offset.z;
+		}
+	}
+}
+
+//Nearest neighbours through the grid: the first cells are about as wide as the spacing of n
+//points over the anchors' bounds, and double until every guide has found a neighbour
+double FurInterpolator::meanSpacing() const {
+	int n = (int)anchors.size();
+	if (n < 2) return guides.empty() ? 0 : length(guides[0].back() - guides[0].front());
+	Box bounds;
+	for (int a = 0; a < n; a++) bounds.add(anchors[a]);
+	double extent = length(bounds.extent());
+	if (!(extent > 0)) return 0;
+
+	std::vector<double> nearest(n, -1.0);
+	int left = n;
+	GuideGrid search;
+	for (double cell = extent / std::sqrt((double)n); left > 0; cell *= 2) {
+		search.build(anchors, cell);
+		for (int a = 0; a < n; a++) {
+			if (nearest[a] >= 0) continue;
+			int found[kMaxBlend];
+			double dist2[kMaxBlend];
+			int count = search.nearest(anchors, anchors[a], cell, found, dist2);
+			for (int i = 0; i < count; i++) {
+				if (found[i] == a) continue;
+				nearest[a] = std::sqrt(dist2[i]);
+				left--;
+				break;
+			}
+		}
+	}
+	double sum = 0;
+	for (int a = 0; a < n; a++) sum += nearest[a];
+	return sum / n;
+}
+
+//Rotation taking unit vector a onto unit vector b (Rodrigues), as a row major 3x3
+static void rotationBetween(const Vec3& a, const Vec3& b, float r[9]) {
+	Vec3 v = cross(a, b);
+	double c = dot(a, b);
+	if (c < -0.999999) {
+		//opposite: half a turn about any axis perpendicular to a
+		Vec3 axis = normalize(std::fabs(a.x) < 0.9 ? cross(a, Vec3(1, 0, 0)) : cross(a, Vec3(0, 1, 0)));
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++) r[3 * i + j] = (float)(2 * axis[i] * axis[j] - (i == j ? 1 : 0));
+		return;
+	}
+	double k = 1 / (1 + c);
+	r[0] = (float)(c + v.x * v.x * k);       r[1] = (float)(v.x * v.y * k - v.z); r[2] = (float)(v.x * v.z * k + v.y);
+	r[3] = (float)(v.y * v.x * k + v.z);     r[4] = (float)(c + v.y * v.y * k);   r[5] = (float)(v.y * v.z * k - v.x);
+	r[6] = (float)(v.z * v.x * k - v.y);     r[7] = (float)(v.z * v.y * k + v.x); r[8] = (float)(c + v.z * v.z * k);
+}
+
+bool FurInterpolator::prepare(const SceneBVH& scene, double radius) {
+	children = 0;
+	cx.clear(); cy.clear(); cz.clear();
+	radiusUsed = 0;
+	if (guides.empty() || scene.empty()) return false;
+
+	prepareGuides(scene);
+	radiusUsed = radius > 0 ? radius : 2 * meanSpacing();
+	if (!(radiusUsed > 0)) return false;
+	grid.build(anchors, radiusUsed);
+	return true;
+}
+
+bool FurInterpolator::covers(const Vec3& p) const {
+	int found[kMaxBlend];
+	double dist2[kMaxBlend];
+	return radiusUsed > 0 && grid.nearest(anchors, p, radiusUsed, found, dist2) > 0;
+}
+
+int FurInterpolator::interpolate(const SceneBVH& scene, int count, double radius, ThreadPool& pool, unsigned seed) {
+	if (count <= 0 || !prepare(scene, radius)) return 0;
+
+	//area of every triangle with a guide in reach of its centroid, accumulated for sampling
+	int triangles = scene.triangleCount();
+	std::vector<double> area(triangles, 0.0);
+	pool.parallelFor(triangles, [&](int t) {
+		Vec3 a, b, c;
+		scene.triangle(t, a, b, c);
+		if (covers((a + b + c) / 3)) area[t] = 0.5 * length(cross(b - a, c - a));
+	}, 1024);
+	for (int t = 1; t < triangles; t++) area[t] += area[t - 1];
+	if (!(area.back() > 0)) return 0;
+
+	//roots are drawn up front from one generator so the result doesn't depend on the threads
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> unit(0, 1);
+	std::vector<Vec3> roots(count), rootNormals(count);
+	for (int c = 0; c < count; c++) {
+		int t = (int)(std::upper_bound(area.begin(), area.end(), unit(random) * area.back()) - area.begin());
+		t = std::min(t, triangles - 1);
+		Vec3 a, b, v;
+		scene.triangle(t, a, b, v);
+		double u = unit(random), w = unit(random);
+		if (u + w > 1) { u = 1 - u; w = 1 - w; }
+		roots[c] = a + (b - a) * u + (v - a) * w;
+		rootNormals[c] = normalize(cross(b - a, v - a));
+	}
+	return grow(roots, rootNormals, pool);
+}
+
+int FurInterpolator::interpolate(const SceneBVH& scene, const std::vector<Vec3>& roots,
+	const std::vector<Vec3>& rootNormals, double radius, ThreadPool& pool) {
+	if (roots.empty() || roots.size() != rootNormals.size() || !prepare(scene, radius)) return 0;
+	return grow(roots, rootNormals, pool);
+}
+
+//blends one child at each root from the guides in reach of it
+int FurInterpolator::grow(const std::vector<Vec3>& roots, const std::vector<Vec3>& rootNormals, ThreadPool& pool) {
+	int count = (int)roots.size();
+
+	size_t points = (size_t)count * perStrand;
+	cx.assign(points, 0.0f);
+	cy.assign(points, 0.0f);
+	cz.assign(points, 0.0f);
+	std::vector<char> grown(count, 0);
+
+	pool.parallelFor(count, [&](int c) {
+		int found[kMaxBlend];
+		double dist2[kMaxBlend];
+		float weight[kMaxBlend];
+		const Vec3& p = roots[c];
+		int n = grid.nearest(anchors, p, radiusUsed, found, dist2);
+		if (n == 0) return;
+
+		//inside the triangle of the three nearest guides, their barycentric coordinates
+		int blend = 0;
+		if (n >= 3) {
+			Vec3 a = anchors[found[0]], b = anchors[found[1]], v = anchors[found[2]];
+			Vec3 m = cross(b - a, v - a);
+			double m2 = length2(m);
+			if (m2 > 1e-24) {
+				double wa = dot(cross(b - p, v - p), m) / m2;
+				double wb = dot(cross(v - p, a - p), m) / m2;
+				double wc = 1 - wa - wb;
+				if (wa >= 0 && wb >= 0 && wc >= 0) {
+					weight[0] = (float)wa; weight[1] = (float)wb; weight[2] = (float)wc;
+					blend = 3;
+				}
+			}
+		}
+		//otherwise inverse squared distance over every guide in reach
+		if (blend == 0) {
+			double sum = 0;
+			for (int i = 0; i < n; i++) sum += 1 / (dist2[i] + 1e-12);
+			for (int i = 0; i < n; i++) weight[i] = (float)(1 / (dist2[i] + 1e-12) / sum);
+			blend = n;
+		}
+
+		float* x = &cx[(size_t)c * perStrand];
+		float* y = &cy[(size_t)c * perStrand];
+		float* z = &cz[(size_t)c * perStrand];
+		float height = 0;
+		for (int i = 0; i < blend; i++) {
+			int g = found[i];
+			float w = weight[i];
+			height += w * heights[g];
+			float r[9];
+			rotationBetween(normals[g], rootNormals[c], r);
+			const float* ox = &gx[(size_t)g * perStrand];
+			const float* oy = &gy[(size_t)g * perStrand];
+			const float* oz = &gz[(size_t)g * perStrand];
+			for (int j = 0; j < perStrand; j++) {
+				x[j] += w * (r[0] * ox[j] + r[1] * oy[j] + r[2] * oz[j]);
+				y[j] += w * (r[3] * ox[j] + r[4] * oy[j] + r[5] * oz[j]);
+				z[j] += w * (r[6] * ox[j] + r[7] * oy[j] + r[8] * oz[j]);
+			}
+		}
+
+		Vec3 root = p + rootNormals[c] * height;
+		for (int j = 0; j < perStrand; j++) {
+			x[j] += (float)root.x;
+			y[j] += (float)root.y;
+			z[j] += (float)root.z;
+		}
+		grown[c] = 1;
+	}, kBlendGrain);
+
+	//close the gaps left by children out of reach
+	for (int c = 0; c < count; c++) {
+		if (!grown[c]) continue;
+		if (c != children) {
+			std::copy(cx.begin() + (size_t)c * perStrand, cx.begin() + (size_t)(c + 1) * perStrand, cx.begin() + (size_t)children * perStrand);
+			std::copy(cy.begin() + (size_t)c * perStrand, cy.begin() + (size_t)(c + 1) * perStrand, cy.begin() + (size_t)children * perStrand);
+			std::copy(cz.begin() + (size_t)c * perStrand, cz.begin() + (size_t)(c + 1) * perStrand, cz.begin() + (size_t)children * perStrand);
+		}
+		children++;
+	}
+	cx.resize((size_t)children * perStrand);
+	cy.resize((size_t)children * perStrand);
+	cz.resize((size_t)children * perStrand);
+	return children;
+}
+
+size_t FurInterpolator::memoryBytes() const {
+	size_t guidePoints = 0;
+	for (size_t g = 0; g < guides.size(); g++) guidePoints += guides[g].capacity();
+	return (cx.capacity() + cy.capacity() + cz.capacity()) * sizeof(float)
+		+ (gx.capacity() + gy.capacity() + gz.capacity() + heights.capacity()) * sizeof(float)
+		+ guidePoints * sizeof(Vec3)
+		+ (anchors.capacity() + normals.capacity()) * sizeof(Vec3)
+		+ grid.keys.capacity() * sizeof(long long) + grid.guides.capacity() * sizeof(int);
+}
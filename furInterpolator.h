@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "vec3.h"
+#include "sceneBVH.h"
+
+class ThreadPool;
+
+//Grows dense child hairs from a few optimized guide strands. Children are rooted at random
+//points of the surface near the guides and take their shape from the nearest guides: with
+//barycentric weights when the child lies inside the triangle of its three nearest guides,
+//by inverse distance otherwise. Each guide's shape is turned from its own surface normal to
+//the child's, so children follow the surface. Maya-free.
+//
+//Strands are stored as structure-of-arrays of floats, strand after strand, so blending a
+//guide into a child is a straight loop over contiguous points.
+class FurInterpolator {
+public:
+	FurInterpolator();
+
+	//every guide is resampled to this many points, and children get as many
+	void setPointsPerStrand(int points);
+	int pointsPerStrand() const { return perStrand; }
+
+	//a guide's points from root to tip; false if they don't make a strand
+	bool addGuide(const std::vector<Vec3>& points);
+	//drops every guide whose flag is 0, one flag per guide in the order they were added
+	void keepGuides(const std::vector<char>& keep);
+	void clearGuides();
+	int guideCount() const { return (int)guides.size(); }
+
+	//grows count children over the parts of scene within radius of a guide root, blending on
+	//pool. radius <= 0 uses twice the mean spacing between neighbouring guides. Returns the
+	//number of children grown; children out of reach of every guide are dropped.
+	int interpolate(const SceneBVH& scene, int count, double radius, ThreadPool& pool, unsigned seed = 5489u);
+	//grows one child at each of the given roots instead, with the surface normal there
+	int interpolate(const SceneBVH& scene, const std::vector<Vec3>& roots, const std::vector<Vec3>& rootNormals,
+		double radius, ThreadPool& pool);
+
+	//anchors the guides to scene for a search radius as interpolate does, so covers() can
+	//tell where children would grow; false if there is nothing to grow from
+	bool prepare(const SceneBVH& scene, double radius);
+	//whether a child rooted at p has a guide in reach
+	bool covers(const Vec3& p) const;
+
+	int strandCount() const { return children; }
+	//point j of child c is at c * pointsPerStrand() + j
+	const std::vector<float>& x() const { return cx; }
+	const std::vector<float>& y() const { return cy; }
+	const std::vector<float>& z() const { return cz; }
+	double searchRadius() const { return radiusUsed; }
+	size_t memoryBytes() const;
+
+	//guides a child may blend
+	static const int kMaxBlend = 8;
+
+private:
+	//guides sorted by the grid cell of their surface anchor
+	struct GuideGrid {
+		double cell;
+		std::vector<long long> keys; //sorted, one per guide
+		std::vector<int> guides; //guide index in key order
+
+		void build(const std::vector<Vec3>& points, double cellSize);
+		//up to kMaxBlend guides within radius of p, nearest first; returns how many
+		int nearest(const std::vector<Vec3>& points, const Vec3& p, double radius, int* found, double* dist2) const;
+	};
+
+	void prepareGuides(const SceneBVH& scene);
+	int grow(const std::vector<Vec3>& roots, const std::vector<Vec3>& rootNormals, ThreadPool& pool);
+	double meanSpacing() const;
+
+	int perStrand;
+	std::vector<std::vector<Vec3> > guides;
+
+	//per guide, filled by prepareGuides
+	std::vector<Vec3> anchors; //closest surface point to the root
+	std::vector<Vec3> normals; //surface normal there
+	std::vector<float> heights; //root's height above the anchor
+	std::vector<float> gx, gy, gz; //points relative to the root, perStrand per guide
+	GuideGrid grid;
+
+	int children;
+	std::vector<float> cx, cy, cz;
+	double radiusUsed;
+};
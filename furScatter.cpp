@@ -0,0 +1,383 @@
+#include "furScatter.h"
+#include "threadPool.h"
+#include "brush/EasyBMP.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+
+//items per task for the per triangle and per candidate loops, and tiles per task when placing
+const int kAreaGrain = 4096;
+const int kCandidateGrain = 1024;
+const int kTileGrain = 4;
+//automatic spacing as a fraction of sqrt(area / count); random dart throwing jams at about
+//0.7 * area / spacing^2 roots, so this leaves room for about twice as many as asked for
+const double kAutoSpacing = 0.6;
+//candidates drawn per root still missing, before thinning by the map
+const double kOversample = 2.0;
+const int kMaxRounds = 8;
+//a round placing fewer than this fraction of its candidates means the surface is full
+const double kSaturated = 0.01;
+
+//21 bits per axis, biased so negative cells pack too (as in SparseSDF)
+static long long cellKey(int i, int j, int k) {
+	const long long bias = 1 << 20;
+	return ((i + bias) << 42) | ((j + bias) << 21) | (k + bias);
+}
+
+static void cellCoords(const Vec3& p, double size, int cell[3]) {
+	cell[0] = (int)std::floor(p.x / size);
+	cell[1] = (int)std::floor(p.y / size);
+	cell[2] = (int)std::floor(p.z / size);
+}
+
+//placement works through tiles of 4x4x4 cells
+static int tileOf(int cell) {
+	return cell >= 0 ? cell / 4 : (cell - 3) / 4;
+}
+
+//Open addressing table from cell key to a dense cell index. Only grows between phases, so
+//lookups during a phase never race with an insert. The 64 cells of a tile hash to 64
+//consecutive slots, so a tile's placements keep hitting the same few cache lines.
+struct CellHash {
+	struct Slot {
+		long long key;
+		int cell; //-1 marks an empty slot
+	};
+	std::vector<Slot> slots;
+	int used;
+
+	CellHash() : used(0) {}
+
+	static size_t mix(long long key) {
+		//the low 2 bits of each axis are the cell within its tile (the key's bias is a multiple of 4)
+		const long long within = 3LL | (3LL << 21) | (3LL << 42);
+		unsigned long long tile = (unsigned long long)(key & ~within) * 0x9E3779B97F4A7C15ULL;
+		size_t local = (size_t)((key & 3) | ((key >> 19) & 12) | ((key >> 38) & 48));
+		return (size_t)((tile >> 32) << 6) | local;
+	}
+
+	int find(long long key) const {
+		if (slots.empty()) return -1;
+		size_t mask = slots.size() - 1;
+		for (size_t at = mix(key) & mask;; at = (at + 1) & mask) {
+			if (slots[at].cell < 0) return -1;
+			if (slots[at].key == key) return slots[at].cell;
+		}
+	}
+
+	//the key's cell, numbered in insertion order
+	int insert(long long key) {
+		if (2 * (size_t)(used + 1) > slots.size()) grow();
+		size_t mask = slots.size() - 1;
+		size_t at = mix(key) & mask;
+		for (; slots[at].cell >= 0; at = (at + 1) & mask) {
+			if (slots[at].key == key) return slots[at].cell;
+		}
+		slots[at].key = key;
+		slots[at].cell = used;
+		return used++;
+	}
+
+	void grow() {
+		std::vector<Slot> old;
+		old.swap(slots);
+		Slot empty = { 0, -1 };
+		slots.assign(std::max((size_t)1024, 2 * old.size()), empty);
+		size_t mask = slots.size() - 1;
+		for (size_t s = 0; s < old.size(); s++) {
+			if (old[s].cell < 0) continue;
+			size_t at = mix(old[s].key) & mask;
+			while (slots[at].cell >= 0) at = (at + 1) & mask;
+			slots[at] = old[s];
+		}
+	}
+};
+
+FurScatter::FurScatter() {
+	mapWidth = 0;
+	mapHeight = 0;
+	spacing = 0;
+	candidates = 0;
+}
+
+bool FurScatter::loadDensityMap(const char* file) {
+	BMP image;
+	if (!image.ReadFromFile(file)) return false;
+	int width = image.TellWidth(), height = image.TellHeight();
+	if (width <= 0 || height <= 0) return false;
+	std::vector<float> values((size_t)width * height);
+	for (int j = 0; j < height; j++)
+		for (int i = 0; i < width; i++) {
+			RGBApixel pixel = image.GetPixel(i, j);
+			values[(size_t)j * width + i] = (0.299f * pixel.Red + 0.587f * pixel.Green + 0.114f * pixel.Blue) / 255.0f;
+		}
+	setDensityMap(width, height, values);
+	return true;
+}
+
+void FurScatter::setDensityMap(int width, int height, const std::vector<float>& values) {
+	if (width <= 0 || height <= 0 || values.size() < (size_t)width * height) {
+		clearDensityMap();
+		return;
+	}
+	mapWidth = width;
+	mapHeight = height;
+	density.assign(values.begin(), values.begin() + (size_t)width * height);
+}
+
+void FurScatter::clearDensityMap() {
+	mapWidth = 0;
+	mapHeight = 0;
+	density.clear();
+}
+
+void FurScatter::clearSurface() {
+	verts.clear();
+	tris.clear();
+	uv.clear();
+	hasUV.clear();
+}
+
+void FurScatter::addTriangles(const std::vector<Vec3>& vertices, const std::vector<int>& triangles,
+	const std::vector<float>& uvs, const std::vector<char>& mapped) {
+	int before = triangleCount();
+	int offset = (int)verts.size();
+	verts.insert(verts.end(), vertices.begin(), vertices.end());
+	for (size_t i = 0; i < triangles.size(); i++) tris.push_back(triangles[i] + offset);
+	int after = triangleCount();
+
+	//UVs are only stored once some mesh has them; meshes without any get full density
+	bool given = uvs.size() >= 6 * (size_t)(after - before);
+	if (!given && uv.empty()) return;
+	uv.resize(6 * (size_t)before, 0.0f);
+	hasUV.resize(before, 0);
+	if (given) uv.insert(uv.end(), uvs.begin(), uvs.begin() + 6 * (size_t)(after - before));
+	else uv.resize(6 * (size_t)after, 0.0f);
+	if (given && mapped.size() >= (size_t)(after - before)) {
+		hasUV.insert(hasUV.end(), mapped.begin(), mapped.begin() + (after - before));
+	} else {
+		hasUV.resize(after, given ? 1 : 0);
+	}
+}
+
+//v = 0 is the bottom row of the image, as in Maya's UV space
+float FurScatter::densityAt(float u, float v) const {
+	double x = u * mapWidth - 0.5, y = (1 - v) * mapHeight - 0.5;
+	if (!(x == x) || !(y == y)) return 0;
+	double fx = std::floor(x), fy = std::floor(y);
+	float sx = (float)(x - fx), sy = (float)(y - fy);
+	int i0 = (int)std::fmod(fx, (double)mapWidth), j0 = (int)std::fmod(fy, (double)mapHeight);
+	if (i0 < 0) i0 += mapWidth;
+	if (j0 < 0) j0 += mapHeight;
+	int i1 = (i0 + 1) % mapWidth, j1 = (j0 + 1) % mapHeight;
+	float top = density[(size_t)j0 * mapWidth + i0] * (1 - sx) + density[(size_t)j0 * mapWidth + i1] * sx;
+	float bottom = density[(size_t)j1 * mapWidth + i0] * (1 - sx) + density[(size_t)j1 * mapWidth + i1] * sx;
+	return top * (1 - sy) + bottom * sy;
+}
+
+//at barycentric u, v of triangle t, which must have UVs
+float FurScatter::densityAt(int t, float u, float v) const {
+	const float* corner = &uv[6 * (size_t)t];
+	float w = 1 - u - v;
+	return densityAt(w * corner[0] + u * corner[2] + v * corner[4], w * corner[1] + u * corner[3] + v * corner[5]);
+}
+
+//Vose's method, linear in the number of triangles
+void FurScatter::buildAliasTable(const std::vector<double>& weights) {
+	int n = (int)weights.size();
+	double sum = 0;
+	for (int t = 0; t < n; t++) sum += weights[t];
+	aliasProbability.assign(n, 1.0f);
+	aliasIndex.resize(n);
+	std::vector<double> scaled(n);
+	std::vector<int> under, over; //scaled weight below and at least 1
+	for (int t = 0; t < n; t++) {
+		aliasIndex[t] = t;
+		scaled[t] = weights[t] * n / sum;
+		if (scaled[t] < 1) under.push_back(t);
+		else over.push_back(t);
+	}
+	while (!under.empty() && !over.empty()) {
+		int s = under.back(), l = over.back();
+		under.pop_back();
+		aliasProbability[s] = (float)scaled[s];
+		aliasIndex[s] = l;
+		scaled[l] -= 1 - scaled[s];
+		if (scaled[l] < 1) {
+			over.pop_back();
+			under.push_back(l);
+		}
+	}
+	//whatever is left is 1 up to rounding and keeps itself
+}
+
+int FurScatter::scatter(int count, double spacingWanted, ThreadPool& pool, unsigned seed) {
+	rootPoints.clear();
+	rootNormals.clear();
+	spacing = 0;
+	candidates = 0;
+	int triangles = triangleCount();
+	if (triangles == 0 || count <= 0) return 0;
+
+	//triangles are drawn by area times the densest of a few samples of the map over them, so
+	//dark parts of the map cost no candidates; a candidate is then kept with probability
+	//density / bound. Detail finer than the samples over one triangle is clamped to the bound
+	bool mapped = hasDensityMap() && !uv.empty();
+	std::vector<double> weight(triangles);
+	std::vector<float> bound(triangles, 1.0f);
+	pool.parallelFor(triangles, [&](int t) {
+		const int* v = &tris[3 * t];
+		weight[t] = 0.5 * length(cross(verts[v[1]] - verts[v[0]], verts[v[2]] - verts[v[0]]));
+		if (!mapped || !hasUV[t]) return;
+		static const float samples[7][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 0.5f, 0 }, { 0.5f, 0.5f }, { 0, 0.5f }, { 1 / 3.0f, 1 / 3.0f } };
+		float most = 0;
+		for (int i = 0; i < 7; i++) most = std::max(most, densityAt(t, samples[i][0], samples[i][1]));
+		bound[t] = std::min(most, 1.0f);
+		weight[t] *= bound[t];
+	}, kAreaGrain);
+	double total = 0;
+	for (int t = 0; t < triangles; t++) total += weight[t];
+	if (!(total > 0)) return 0;
+	buildAliasTable(weight);
+
+	//the cell coordinates must fit cellKey, so the spacing can't be too small for the surface
+	Box box;
+	for (size_t i = 0; i < verts.size(); i++) box.add(verts[i]);
+	Vec3 extent = box.extent();
+	double minSpacing = std::max(extent.x, std::max(extent.y, extent.z)) / (1 << 19);
+
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> unit(0, 1);
+
+	CellHash hash;
+	std::vector<std::vector<Vec3> > cellRoots; //by dense cell index
+	double keptFraction = 1;
+
+	for (int round = 0; round < kMaxRounds && (int)rootPoints.size() < count; round++) {
+		int missing = count - (int)rootPoints.size();
+		double wanted = std::ceil(missing * kOversample / std::max(keptFraction, 0.01));
+		int draw = (int)std::min(wanted, std::max(4.0 * count, 65536.0));
+		candidates += draw;
+
+		//random numbers come from one generator so the roots don't depend on the threads
+		std::vector<int> tri(draw);
+		std::vector<float> bu(draw), bv(draw), thin(draw);
+		for (int c = 0; c < draw; c++) {
+			int t = std::min((int)(unit(random) * triangles), triangles - 1);
+			if (unit(random) >= aliasProbability[t]) t = aliasIndex[t];
+			double u = unit(random), v = unit(random);
+			if (u + v > 1) { u = 1 - u; v = 1 - v; }
+			tri[c] = t;
+			bu[c] = (float)u;
+			bv[c] = (float)v;
+			thin[c] = (float)unit(random);
+		}
+
+		std::vector<Vec3> point(draw);
+		std::vector<char> kept(draw);
+		pool.parallelFor(draw, [&](int c) {
+			const int* v = &tris[3 * tri[c]];
+			const Vec3& a = verts[v[0]];
+			point[c] = a + (verts[v[1]] - a) * bu[c] + (verts[v[2]] - a) * bv[c];
+			kept[c] = !mapped || !hasUV[tri[c]] || thin[c] * bound[tri[c]] < densityAt(tri[c], bu[c], bv[c]);
+		}, kCandidateGrain);
+
+		//candidates by tile, each tile's in the order they were drawn
+		std::vector<std::pair<long long, int> > order;
+		for (int c = 0; c < draw; c++) {
+			if (!kept[c]) continue;
+			order.push_back(std::make_pair(0LL, c));
+		}
+		if (round == 0) keptFraction = (double)order.size() / draw;
+		if (order.empty()) {
+			if (keptFraction == 0) break;
+			continue;
+		}
+		if (spacing == 0) {
+			//the area the map leaves, judged from how many candidates it kept
+			spacing = spacingWanted > 0 ? spacingWanted : kAutoSpacing * std::sqrt(total * keptFraction / count);
+			spacing = std::max(spacing, minSpacing);
+		}
+		for (size_t o = 0; o < order.size(); o++) {
+			int cell[3];
+			cellCoords(point[order[o].second], spacing, cell);
+			order[o].first = cellKey(tileOf(cell[0]), tileOf(cell[1]), tileOf(cell[2]));
+		}
+		std::sort(order.begin(), order.end());
+
+		//one group per occupied tile, sorted into 8 phases by tile coordinates mod 2
+		std::vector<int> groupStart, cellOf(order.size());
+		std::vector<std::vector<int> > phases(8);
+		for (size_t o = 0; o < order.size(); o++) {
+			int cell[3];
+			cellCoords(point[order[o].second], spacing, cell);
+			cellOf[o] = hash.insert(cellKey(cell[0], cell[1], cell[2]));
+			if (o > 0 && order[o].first == order[o - 1].first) continue;
+			int phase = (tileOf(cell[0]) & 1) * 4 + (tileOf(cell[1]) & 1) * 2 + (tileOf(cell[2]) & 1);
+			phases[phase].push_back((int)groupStart.size());
+			groupStart.push_back((int)o);
+		}
+		groupStart.push_back((int)order.size());
+		cellRoots.resize(hash.used);
+
+		//tiles of one phase are a whole tile apart, so none reads a cell another one writes
+		double spacing2 = spacing * spacing;
+		std::vector<char> placed(draw, 0);
+		for (int phase = 0; phase < 8; phase++) {
+			const std::vector<int>& groups = phases[phase];
+			pool.parallelFor((int)groups.size(), [&](int g) {
+				int group = groups[g];
+				for (int o = groupStart[group]; o < groupStart[group + 1]; o++) {
+					int c = order[o].second;
+					int at[3];
+					cellCoords(point[c], spacing, at);
+					bool isFree = true;
+					for (int i = at[0] - 1; i <= at[0] + 1 && isFree; i++)
+						for (int j = at[1] - 1; j <= at[1] + 1 && isFree; j++)
+							for (int k = at[2] - 1; k <= at[2] + 1 && isFree; k++) {
+								int cell = hash.find(cellKey(i, j, k));
+								if (cell < 0) continue;
+								const std::vector<Vec3>& roots = cellRoots[cell];
+								for (size_t r = 0; r < roots.size(); r++) {
+									if (length2(roots[r] - point[c]) < spacing2) { isFree = false; break; }
+								}
+							}
+					if (!isFree) continue;
+					cellRoots[cellOf[o]].push_back(point[c]);
+					placed[c] = 1;
+				}
+			}, kTileGrain);
+		}
+
+		int before = (int)rootPoints.size();
+		for (int c = 0; c < draw; c++) {
+			if (!placed[c]) continue;
+			const int* v = &tris[3 * tri[c]];
+			rootPoints.push_back(point[c]);
+			rootNormals.push_back(normalize(cross(verts[v[1]] - verts[v[0]], verts[v[2]] - verts[v[0]])));
+		}
+		if ((int)rootPoints.size() - before < kSaturated * order.size()) break;
+	}
+
+	//the last round may overshoot; drop a random subset so no region loses more than another
+	int placedCount = (int)rootPoints.size();
+	if (placedCount > count) {
+		for (int r = 0; r < count; r++) {
+			int pick = std::uniform_int_distribution<int>(r, placedCount - 1)(random);
+			std::swap(rootPoints[r], rootPoints[pick]);
+			std::swap(rootNormals[r], rootNormals[pick]);
+		}
+		rootPoints.resize(count);
+		rootNormals.resize(count);
+	}
+	return (int)rootPoints.size();
+}
+
+size_t FurScatter::memoryBytes() const {
+	return density.capacity() * sizeof(float)
+		+ verts.capacity() * sizeof(Vec3) + tris.capacity() * sizeof(int)
+		+ uv.capacity() * sizeof(float) + hasUV.capacity()
+		+ aliasProbability.capacity() * sizeof(float) + aliasIndex.capacity() * sizeof(int)
+		+ (rootPoints.capacity() + rootNormals.capacity()) * sizeof(Vec3);
+}
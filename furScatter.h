@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "vec3.h"
+
+class ThreadPool;
+
+//Places fur roots over triangles as blue noise: no two roots are closer than the spacing, and
+//an optional greyscale map over UV space thins them out where it is dark. Maya-free.
+//
+//Candidates are drawn from an alias table over the triangles, weighted by area times the most
+//the map asks for on each, and thinned by the map. They are then accepted or rejected against
+//the roots already placed, through a spatial hash of cells as wide as the spacing. Cells are
+//grouped into tiles of 4x4x4, and tiles are processed in 8 phases (by tile coordinates mod 2):
+//tiles of one phase never share a neighbouring cell, so they can be decided in parallel.
+//Within a tile, candidates are taken in the random order they were drawn. Rounds of fresh
+//candidates continue until enough roots are placed or the surface is full.
+class FurScatter {
+public:
+	FurScatter();
+
+	//greyscale .bmp read with EasyBMP; white is full density. False if it can't be read
+	bool loadDensityMap(const char* file);
+	//width * height values from the top row down, in [0, 1]
+	void setDensityMap(int width, int height, const std::vector<float>& values);
+	void clearDensityMap();
+	bool hasDensityMap() const { return !density.empty(); }
+
+	void clearSurface();
+	//triangles holds 3 indices into vertices per triangle; uvs holds a u, v pair per triangle
+	//corner (6 per triangle), or is empty when the surface has no UVs (full density there).
+	//mapped flags the triangles whose UVs are real, one per triangle; the others are left at
+	//full density too. Empty means every triangle is mapped when uvs are given
+	void addTriangles(const std::vector<Vec3>& vertices, const std::vector<int>& triangles,
+		const std::vector<float>& uvs, const std::vector<char>& mapped);
+	int triangleCount() const { return (int)(tris.size() / 3); }
+
+	//places up to count roots at least spacing apart; spacing <= 0 derives one from count and
+	//the surface area the map leaves. Returns the number of roots placed
+	int scatter(int count, double spacing, ThreadPool& pool, unsigned seed = 5489u);
+
+	const std::vector<Vec3>& roots() const { return rootPoints; }
+	//face normal under each root
+	const std::vector<Vec3>& normals() const { return rootNormals; }
+	double spacingUsed() const { return spacing; }
+	int candidateCount() const { return candidates; }
+	size_t memoryBytes() const;
+
+private:
+	//density map value at a UV position, bilinear and wrapping like a repeating texture
+	float densityAt(float u, float v) const;
+	float densityAt(int triangle, float u, float v) const;
+	void buildAliasTable(const std::vector<double>& weights);
+
+	int mapWidth, mapHeight;
+	std::vector<float> density;
+
+	std::vector<Vec3> verts;
+	std::vector<int> tris;
+	std::vector<float> uv; //6 per triangle, or empty if no triangle has UVs
+	std::vector<char> hasUV; //per triangle, when uv isn't empty
+
+	//Vose alias table over triangle areas: pick t uniformly, keep it with probability
+	//aliasProbability[t], otherwise take aliasIndex[t]
+	std::vector<float> aliasProbability;
+	std::vector<int> aliasIndex;
+
+	std::vector<Vec3> rootPoints, rootNormals;
+	double spacing;
+	int candidates;
+};
@@ -0,0 +1,403 @@
+#include "meshBVH.h"
+#include <algorithm>
+#include <unordered_map>
+
+const int kLeafSize = 4;
+const int kBins = 12;
+const int kStackSize = 128;
+const int kMaxWalkSteps = 64;
+//past this depth splits fall back to the median so traversal stacks cannot overflow
+const int kMaxSAHDepth = 48;
+
+MeshBVH::MeshBVH() {}
+
+void MeshBVH::clear() {
+	nodes.clear(); triOrder.clear(); verts.clear(); tris.clear();
+	faceNormals.clear(); vertexNormals.clear(); edgeNormals.clear();
+	vertexTriStart.clear(); vertexTris.clear();
+	rootBox = Box();
+}
+
+void MeshBVH::build(const std::vector<Vec3>& vertices, const std::vector<int>& triangles) {
+	clear();
+	verts = vertices;
+	tris = triangles;
+
+	int n = triangleCount();
+	if (n == 0) return;
+
+	std::vector<Box> triBoxes(n);
+	std::vector<Vec3> centroids(n);
+	triOrder.resize(n);
+	for (int i = 0; i < n; i++) {
+		const int* t = triangle(i);
+		triBoxes[i].add(verts[t[0]]); triBoxes[i].add(verts[t[1]]); triBoxes[i].add(verts[t[2]]);
+		centroids[i] = triBoxes[i].center();
+		triOrder[i] = i;
+	}
+
+	nodes.reserve(2 * n / kLeafSize + 1);
+	buildRange(0, n, 0, triBoxes, centroids);
+	rootBox = nodes[0].box;
+
+	buildNormals();
+	buildAdjacency();
+}
+
+//binned surface area heuristic, falls back to a median split when every bin is equal
+int MeshBVH::buildRange(int begin, int end, int depth, std::vector<Box>& triBoxes, std::vector<Vec3>& centroids) {
+	int nodeIndex = (int)nodes.size();
+	nodes.push_back(Node());
+
+	Box box, centroidBox;
+	for (int i = begin; i < end; i++) {
+		box.add(triBoxes[triOrder[i]]);
+		centroidBox.add(centroids[triOrder[i]]);
+	}
+	nodes[nodeIndex].box = box;
+
+	int count = end - begin;
+	if (count <= kLeafSize) {
+		nodes[nodeIndex].index = begin;
+		nodes[nodeIndex].count = count;
+		return nodeIndex;
+	}
+
+	//choose the widest centroid axis
+	Vec3 ext = centroidBox.extent();
+	int axis = 0;
+	if (ext.y > ext[axis]) axis = 1;
+	if (ext.z > ext[axis]) axis = 2;
+
+	int mid = begin + count / 2;
+	if (ext[axis] > 0 && depth < kMaxSAHDepth) {
+		Box binBoxes[kBins];
+		int binCounts[kBins] = { 0 };
+		double scale = kBins / ext[axis];
+		for (int i = begin; i < end; i++) {
+			int b = std::min(kBins - 1, (int)((centroids[triOrder[i]][axis] - centroidBox.lo[axis]) * scale));
+			binCounts[b]++;
+			binBoxes[b].add(triBoxes[triOrder[i]]);
+		}
+
+		//sweep from the right to get the cost of every split plane
+		double rightArea[kBins];
+		int rightCount[kBins];
+		Box acc;
+		int accCount = 0;
+		for (int b = kBins - 1; b > 0; b--) {
+			acc.add(binBoxes[b]); accCount += binCounts[b];
+			rightArea[b] = acc.area(); rightCount[b] = accCount;
+		}
+
+		double bestCost = 1e300;
+		int bestSplit = -1;
+		acc = Box(); accCount = 0;
+		for (int b = 1; b < kBins; b++) {
+			acc.add(binBoxes[b - 1]); accCount += binCounts[b - 1];
+			if (accCount == 0 || rightCount[b] == 0) continue;
+			double cost = acc.area() * accCount + rightArea[b] * rightCount[b];
+			if (cost < bestCost) { bestCost = cost; bestSplit = b; }
+		}
+
+		if (bestSplit > 0) {
+			double lo = centroidBox.lo[axis];
+			int* split = std::partition(&triOrder[0] + begin, &triOrder[0] + end, [&](int t) {
+				return std::min(kBins - 1, (int)((centroids[t][axis] - lo) * scale)) < bestSplit;
+			});
+			mid = (int)(split - &triOrder[0]);
+		}
+	}
+	if (mid == begin || mid == end || ext[axis] <= 0 || depth >= kMaxSAHDepth) {
+		mid = begin + count / 2;
+		std::nth_element(&triOrder[0] + begin, &triOrder[0] + mid, &triOrder[0] + end, [&](int a, int b) {
+			return centroids[a][axis] < centroids[b][axis];
+		});
+	}
+
+	buildRange(begin, mid, depth + 1, triBoxes, centroids);
+	int right = buildRange(mid, end, depth + 1, triBoxes, centroids);
+	nodes[nodeIndex].index = right;
+	nodes[nodeIndex].count = 0;
+	return nodeIndex;
+}
+
+//angle weighted pseudo normals (Baerentzen & Aanaes) give a robust inside/outside sign
+void MeshBVH::buildNormals() {
+	int n = triangleCount();
+	faceNormals.assign(n, Vec3());
+	vertexNormals.assign(verts.size(), Vec3());
+	edgeNormals.assign(3 * n, Vec3());
+
+	std::unordered_map<unsigned long long, Vec3> edgeSums;
+	edgeSums.reserve(3 * n / 2 + 1);
+
+	for (int i = 0; i < n; i++) {
+		const int* t = triangle(i);
+		Vec3 fn = normalize(cross(verts[t[1]] - verts[t[0]], verts[t[2]] - verts[t[0]]));
+		faceNormals[i] = fn;
+		for (int k = 0; k < 3; k++) {
+			int a = t[k], b = t[(k + 1) % 3], c = t[(k + 2) % 3];
+			Vec3 e1 = normalize(verts[b] - verts[a]);
+			Vec3 e2 = normalize(verts[c] - verts[a]);
+			double cosine = std::max(-1.0, std::min(1.0, dot(e1, e2)));
+			vertexNormals[a] += fn * std::acos(cosine);
+
+			unsigned long long key = ((unsigned long long)std::min(a, b) << 32) | (unsigned)std::max(a, b);
+			edgeSums[key] += fn;
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		const int* t = triangle(i);
+		for (int k = 0; k < 3; k++) {
+			int a = t[k], b = t[(k + 1) % 3];
+			unsigned long long key = ((unsigned long long)std::min(a, b) << 32) | (unsigned)std::max(a, b);
+			edgeNormals[3 * i + k] = normalize(edgeSums[key]);
+		}
+	}
+	for (size_t v = 0; v < vertexNormals.size(); v++) vertexNormals[v] = normalize(vertexNormals[v]);
+}
+
+void MeshBVH::buildAdjacency() {
+	int n = triangleCount();
+	vertexTriStart.assign(verts.size() + 1, 0);
+	for (size_t i = 0; i < tris.size(); i++) vertexTriStart[tris[i] + 1]++;
+	for (size_t v = 0; v < verts.size(); v++) vertexTriStart[v + 1] += vertexTriStart[v];
+
+	std::vector<int> fill(vertexTriStart.begin(), vertexTriStart.end() - 1);
+	vertexTris.resize(tris.size());
+	for (int t = 0; t < n; t++)
+		for (int k = 0; k < 3; k++) vertexTris[fill[tris[3 * t + k]]++] = t;
+}
+
+Vec3 closestPointOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c,
+	double& u, double& v, int& feature) {
+	Vec3 ab = b - a, ac = c - a, ap = p - a;
+	double d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if (d1 <= 0 && d2 <= 0) { u = 0; v = 0; feature = 0; return a; }
+
+	Vec3 bp = p - b;
+	double d3 = dot(ab, bp), d4 = dot(ac, bp);
+	if (d3 >= 0 && d4 <= d3) { u = 1; v = 0; feature = 1; return b; }
+
+	double vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+		double w = d1 / (d1 - d3);
+		u = w; v = 0; feature = 3;
+		return a + ab * w;
+	}
+
+	Vec3 cp = p - c;
+	double d5 = dot(ab, cp), d6 = dot(ac, cp);
+	if (d6 >= 0 && d5 <= d6) { u = 0; v = 1; feature = 2; return c; }
+
+	double vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+		double w = d2 / (d2 - d6);
+		u = 0; v = w; feature = 5;
+		return a + ac * w;
+	}
+
+	double va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+		double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		u = 1 - w; v = w; feature = 4;
+		return b + (c - b) * w;
+	}
+
+	double sum = va + vb + vc;
+	if (sum <= 0) { u = 0; v = 0; feature = 0; return a; } //degenerate triangle
+	u = vb / sum; v = vc / sum; feature = 6;
+	return a + ab * u + ac * v;
+}
+
+bool MeshBVH::closestPoint(const Vec3& p, ClosestHit& hit, double maxDistance) const {
+	if (nodes.empty()) return false;
+
+	double best2 = maxDistance < 1e150 ? maxDistance * maxDistance : 1e300;
+	bool found = false;
+
+	int stack[kStackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		if (node.box.distance2(p) >= best2) continue;
+
+		if (node.count > 0) {
+			for (int i = node.index; i < node.index + node.count; i++) {
+				int tri = triOrder[i];
+				const int* t = triangle(tri);
+				double u, v;
+				int feature;
+				Vec3 q = closestPointOnTriangle(p, verts[t[0]], verts[t[1]], verts[t[2]], u, v, feature);
+				double d2 = length2(q - p);
+				if (d2 < best2) {
+					best2 = d2; found = true;
+					hit.point = q; hit.triangle = tri; hit.u = u; hit.v = v; hit.feature = feature;
+				}
+			}
+			continue;
+		}
+
+		//visit the nearer child first
+		int left = (int)(&node - &nodes[0]) + 1, right = node.index;
+		double dl = nodes[left].box.distance2(p), dr = nodes[right].box.distance2(p);
+		if (dl < dr) { std::swap(left, right); std::swap(dl, dr); }
+		if (dl < best2) stack[top++] = left;
+		if (dr < best2) stack[top++] = right;
+	}
+
+	if (found) hit.distance = std::sqrt(best2);
+	return found;
+}
+
+double MeshBVH::triangleDistance2(const Vec3& p, int tri, ClosestHit& hit) const {
+	const int* t = triangle(tri);
+	hit.point = closestPointOnTriangle(p, verts[t[0]], verts[t[1]], verts[t[2]], hit.u, hit.v, hit.feature);
+	hit.triangle = tri;
+	return length2(hit.point - p);
+}
+
+bool MeshBVH::closestPointNear(const Vec3& p, int hint, ClosestHit& hit) const {
+	if (hint < 0 || hint >= triangleCount()) return closestPoint(p, hit);
+
+	//walk the one-ring of the current triangle's vertices while something there is closer
+	ClosestHit best, candidate;
+	double best2 = triangleDistance2(p, hint, best);
+	for (int step = 0; step < kMaxWalkSteps; step++) {
+		int current = best.triangle;
+		const int* t = triangle(current);
+		for (int k = 0; k < 3; k++) {
+			for (int i = vertexTriStart[t[k]]; i < vertexTriStart[t[k] + 1]; i++) {
+				int other = vertexTris[i];
+				if (other == current) continue;
+				double d2 = triangleDistance2(p, other, candidate);
+				if (d2 < best2) { best2 = d2; best = candidate; }
+			}
+		}
+		if (best.triangle == current) break;
+	}
+
+	//the walk only finds a local minimum; anything closer elsewhere lies inside its radius
+	best.distance = std::sqrt(best2);
+	hit = best;
+	ClosestHit closer;
+	if (closestPoint(p, closer, best.distance * (1 - 1e-12))) hit = closer;
+	return true;
+}
+
+static Vec3 inverseDirection(const Vec3& d) {
+	return Vec3(d.x != 0 ? 1 / d.x : 1e300, d.y != 0 ? 1 / d.y : 1e300, d.z != 0 ? 1 / d.z : 1e300);
+}
+
+//Moller-Trumbore, returns false for parallel rays
+static bool rayTriangle(const Vec3& o, const Vec3& d, const Vec3& a, const Vec3& b, const Vec3& c,
+	double& t, double& u, double& v) {
+	Vec3 e1 = b - a, e2 = c - a;
+	Vec3 pv = cross(d, e2);
+	double det = dot(e1, pv);
+	if (std::fabs(det) < 1e-20) return false;
+	double inv = 1 / det;
+	Vec3 tv = o - a;
+	u = dot(tv, pv) * inv;
+	if (u < 0 || u > 1) return false;
+	Vec3 qv = cross(tv, e1);
+	v = dot(d, qv) * inv;
+	if (v < 0 || u + v > 1) return false;
+	t = dot(e2, qv) * inv;
+	return true;
+}
+
+bool MeshBVH::raycast(const Vec3& origin, const Vec3& direction, RayHit& hit, double tMax) const {
+	if (nodes.empty()) return false;
+
+	Vec3 invDir = inverseDirection(direction);
+	double best = tMax;
+	bool found = false;
+
+	int stack[kStackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		double tNear = 0, tFar = best;
+		if (!node.box.intersect(origin, invDir, tNear, tFar)) continue;
+
+		if (node.count > 0) {
+			for (int i = node.index; i < node.index + node.count; i++) {
+				int tri = triOrder[i];
+				const int* t = triangle(tri);
+				double th, u, v;
+				if (rayTriangle(origin, direction, verts[t[0]], verts[t[1]], verts[t[2]], th, u, v)
+					&& th >= 0 && th <= best) {
+					best = th; found = true;
+					hit.t = th; hit.triangle = tri; hit.u = u; hit.v = v;
+				}
+			}
+			continue;
+		}
+
+		int left = (int)(&node - &nodes[0]) + 1, right = node.index;
+		double ln = 0, lf = best, rn = 0, rf = best;
+		bool hl = nodes[left].box.intersect(origin, invDir, ln, lf);
+		bool hr = nodes[right].box.intersect(origin, invDir, rn, rf);
+		if (hl && hr) {
+			//push the farther child first so the nearer one is popped next
+			if (ln < rn) { stack[top++] = right; stack[top++] = left; }
+			else { stack[top++] = left; stack[top++] = right; }
+		}
+		else if (hl) stack[top++] = left;
+		else if (hr) stack[top++] = right;
+	}
+	return found;
+}
+
+bool MeshBVH::intersects(const Vec3& origin, const Vec3& direction) const {
+	if (nodes.empty()) return false;
+
+	Vec3 invDir = inverseDirection(direction);
+	int stack[kStackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		double tNear = 0, tFar = 1e300;
+		if (!node.box.intersect(origin, invDir, tNear, tFar)) continue;
+
+		if (node.count > 0) {
+			for (int i = node.index; i < node.index + node.count; i++) {
+				const int* t = triangle(triOrder[i]);
+				double th, u, v;
+				if (rayTriangle(origin, direction, verts[t[0]], verts[t[1]], verts[t[2]], th, u, v) && th >= 0)
+					return true;
+			}
+			continue;
+		}
+		stack[top++] = (int)(&node - &nodes[0]) + 1;
+		stack[top++] = node.index;
+	}
+	return false;
+}
+
+Vec3 MeshBVH::pseudoNormal(const ClosestHit& hit) const {
+	if (hit.triangle < 0) return Vec3();
+	if (hit.feature < 3) return vertexNormals[triangle(hit.triangle)[hit.feature]];
+	if (hit.feature < 6) return edgeNormals[3 * hit.triangle + hit.feature - 3];
+	return faceNormals[hit.triangle];
+}
+
+double MeshBVH::signedDistance(const Vec3& p, ClosestHit* hitOut) const {
+	ClosestHit hit;
+	if (!closestPoint(p, hit)) return 1e300;
+	if (hitOut) *hitOut = hit;
+	return dot(p - hit.point, pseudoNormal(hit)) < 0 ? -hit.distance : hit.distance;
+}
+
+size_t MeshBVH::memoryBytes() const {
+	return nodes.capacity() * sizeof(Node)
+		+ (vertexTriStart.capacity() + vertexTris.capacity()) * sizeof(int)
+		+ triOrder.capacity() * sizeof(int)
+		+ tris.capacity() * sizeof(int)
+		+ (verts.capacity() + vertexNormals.capacity() + faceNormals.capacity() + edgeNormals.capacity()) * sizeof(Vec3);
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "vec3.h"
+
+//Result of a closest point query
+struct ClosestHit {
+	Vec3 point;
+	double distance;
+	int triangle;
+	double u, v; //barycentric coordinates of point for the triangle's 2nd and 3rd vertex
+	int feature; //0-2 = vertex, 3-5 = edge (v0v1, v1v2, v2v0), 6 = face interior
+
+	ClosestHit() : distance(1e300), triangle(-1), u(0), v(0), feature(6) {}
+};
+
+//Result of a ray query, point = origin + t*direction
+struct RayHit {
+	double t;
+	int triangle;
+	double u, v;
+
+	RayHit() : t(1e300), triangle(-1), u(0), v(0) {}
+};
+
+//Bounding volume hierarchy over the triangles of one mesh.
+//Maya-free so it can be built, queried and timed outside of the plug-in.
+//All queries are const and may be issued from any number of threads once built.
+class MeshBVH {
+public:
+	MeshBVH();
+
+	//triangles holds 3 vertex indices per triangle
+	void build(const std::vector<Vec3>& vertices, const std::vector<int>& triangles);
+	void clear();
+	bool empty() const { return nodes.empty(); }
+
+	//nearest surface point to p within maxDistance; false if nothing is that close
+	bool closestPoint(const Vec3& p, ClosestHit& hit, double maxDistance = 1e300) const;
+	//same answer as closestPoint, but starts from a triangle near the expected result (the one
+	//returned for a nearby query) and walks mesh adjacency downhill first. The walk leaves a
+	//tight bound, so confirming it touches only the few nodes inside that radius.
+	//A hint < 0 is a plain closestPoint query.
+	bool closestPointNear(const Vec3& p, int hint, ClosestHit& hit) const;
+	//nearest intersection with t in [0, tMax]
+	bool raycast(const Vec3& origin, const Vec3& direction, RayHit& hit, double tMax = 1e300) const;
+	//true as soon as any triangle is hit with t >= 0
+	bool intersects(const Vec3& origin, const Vec3& direction) const;
+	//negative inside the surface, using angle weighted pseudo normals for the sign
+	double signedDistance(const Vec3& p, ClosestHit* hit = 0) const;
+	//outward direction of the surface at the feature of a closest hit
+	Vec3 pseudoNormal(const ClosestHit& hit) const;
+
+	const Box& bounds() const { return rootBox; }
+	int triangleCount() const { return (int)(tris.size() / 3); }
+	int vertexCount() const { return (int)verts.size(); }
+	const Vec3& vertex(int i) const { return verts[i]; }
+	const int* triangle(int t) const { return &tris[3 * t]; }
+	size_t memoryBytes() const;
+
+private:
+	//leaves have count > 0 and store a range of triOrder; inner nodes store the right child
+	//in 'index', the left child always directly follows its parent
+	struct Node {
+		Box box;
+		int index;
+		int count;
+	};
+
+	int buildRange(int begin, int end, int depth, std::vector<Box>& triBoxes, std::vector<Vec3>& centroids);
+	void buildNormals();
+	void buildAdjacency();
+	double triangleDistance2(const Vec3& p, int tri, ClosestHit& hit) const;
+
+	std::vector<Node> nodes;
+	std::vector<int> triOrder;
+	std::vector<Vec3> verts;
+	std::vector<int> tris;
+	Box rootBox;
+
+	std::vector<Vec3> faceNormals;
+	std::vector<Vec3> vertexNormals;
+	std::vector<Vec3> edgeNormals; //3 per triangle
+
+	//triangles around each vertex: vertexTris[vertexTriStart[v] .. vertexTriStart[v + 1])
+	std::vector<int> vertexTriStart;
+	std::vector<int> vertexTris;
+};
+
+//Closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+Vec3 closestPointOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c,
+	double& u, double& v, int& feature);
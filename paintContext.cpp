@@ -1,24 +1,72 @@
 #include "paintContext.h"
 #include <maya\M3dView.h>
-#include <maya\MItDag.h>
 #include <maya\MPointArray.h>
 #include <maya\MGlobal.h>
+#include <maya\MColor.h>
+#include <maya\MFnDagNode.h>
+#include <maya\MDoubleArray.h>
+#include <maya\MSelectionList.h>
+#include <maya\MIntArray.h>
+#include <maya\MFloatArray.h>
+#include <maya\MEventMessage.h>
+#include <maya\MPlug.h>
+#include <maya\MPlugArray.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <unordered_map>
+#include "paintCurveCmd.h"
+#include "curveFit.h"
+#include "furScatter.h"
 
 const char helpString[] = "Drag with the left mouse button to paint";
-const float kMaxError = 0.05;
-const float DRAW_RESOLUTION = 0.2; //between 1 (very very fine) and 0.1 (pretty coarse) 
 const int thresholdDefault = 3;
+//default fit tolerance; the same as the level set error the optimizer aims for
+const float kMaxFitError = 0.05;
+//VP2 preview: rebuilt at most this often (about once a frame at 60Hz)
+const double kPreviewInterval = 1.0 / 60.0;
+//queued drag positions are turned into rays about this often, so the preview sees every batch
+const double kInputInterval = kPreviewInterval;
+//spray roots follow a Vogel spiral, each turned by the golden angle from the last
+const double kGoldenAngle = 2.39996322972865332;
+const double kFullTurn = 6.28318530717958648;
+//most children interpolateFur and scatterFur make curves for in one go; every one is a
+//transform and a shape in a single undo step
+const int kMaxFurCurves = 50000;
 
 void print(MString s) {
 	MGlobal::displayInfo(s);
 }
 
-paintContext::paintContext()
+paintContext::paintContext() : queue([this](std::vector<StrokeSolver>& solved) { commitStrokes(solved); })
 {
 	setTitleString("Easyl");
 	startLevel = 0;
 	endLevel = 0;
 	mode = LevelMode;
+	optimizer = PointwiseOptimizer;
+	threadCount = 0;
+	session.setThreadPool(&pool);
+	queue.setThreadPool(&pool);
+	useDistanceField = false;
+	voxelSize = 0;
+	narrowBand = 0;
+	fitTolerance = kMaxFitError;
+	lastFlush = 0;
+	batchConvert = false;
+	timeBudget = 0;
+	tolerance = 1e-4;
+	weight_a = 1;
+	weight_l = 1;
+	weight_e = 1;
+	spray = false;
+	sprayCount = 50;
+	sprayRadius = 30;
+	sprayRandom.seed(5489u);
+	childCount = 10000;
+	childRadius = 0;
+	scatterSpacing = 0;
+	inputIdleRegistered = false;
 
 	// Tell the context which XPM (menu icon) to use, currently uses MarqueeTool's xmp
 	setImage("Easyl.xpm", MPxContext::kImage1);
@@ -31,259 +79,233 @@ void paintContext::toolOnSetup(MEvent &)
 	setHelpString(helpString);
 }
 
+//strokes still solving or waiting for conversion belong to this tool, so they land before it goes away
+void paintContext::toolOffCleanup()
+{
+	watchInput(false);
+	queue.setStrokeInProgress(false);
+	queue.finish();
+	convertPending();
+}
+
 void paintContext::getClassName(MString &name) const
 {
 	name.set("paintTool");
 }
 
+//wall clock for the sampler's pen speed
+static double seconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void paintContext::doPressCommon(MEvent & event)
 {
-	//beginning new line; remove all previous temp data
-	rays.clear();
+	queue.setStrokeInProgress(true);
+	watchInput(true);
+	//resolve the target mesh once for the whole stroke
+	session.setDistanceField(useDistanceField, voxelSize, narrowBand, std::max(startLevel, endLevel));
+	session.begin();
 
 	// Extract the event information
 	short x, y;
 	event.getPosition(x, y);
+	input.begin(view);
 	MPoint newOrg = MPoint();
 	MVector newDir = MVector();
-	view.viewToWorld(x, y, newOrg, newDir);
-	lastx = x; lasty = y;
-
-	rays.push_back(PaintRay(newOrg,newDir));
-}
-
-//Converging (FINALLY!!!!!)
-float paintContext::angleTerm(int index) {
-	float output = 0;
-	float dot;
-	MPoint p1,p2,p3;
-	MVector v1, v2;
-
-	//for the first point of a non-level-set stroke, we want to use a control point
-	if (mode != ModeType::LevelMode && index == 1) {
-		//get that mesh
-		MItDag itr(MItDag::kDepthFirst, MFn::kMesh);
-		MObject meshObj = itr.item();
-		MFnMesh mesh(meshObj);
-
-		p2 = rays[0].point(); p3 = rays[1].point();
-		//p1 is now on the mesh surface
-		mesh.getClosestPoint(p2, p1);
-
-		if (mode == ModeType::FurMode) {
-			//prepend a control point (p1) directly toward the mesh from where we are
-			v1 = p2 - p1; v2 = p3 - p2;
-			dot = v1.normal() * v2.normal();
-			//assess cost of first angle based on the existence of that point
-			output += pow(1 - dot, 2);
-		}
-		else if (mode == ModeType::FeatherMode) {
-			//we want the cross of the point-to-surface and (the point-to-surface and the point-to-last-point)
-			v1 = (p1 - p2) ^ ((p1 - p2) ^ (rays[rays.size() - 1].point() - p2)); v2 = p3 - p2;
-			dot = -(v1.normal()) * v2.normal();
-			//again, always calculate that first dot
-			output += pow(1 - dot, 2) * 2;
-		}
-	} 
-	
-	//for the interior points of every stroke, we optimize for straightness
-	else if (index > 1 && index < rays.size()) {
-		//get unit vectors representing consecutive stroke segments
-		p1 = rays[index-2].point(); p2 = rays[index-1].point(); p3 = rays[index].point();
-		v1 = p2 - p1; v2 = p3 - p2;
-		dot = v1.normal() * v2.normal();
-
-		//output the 'cost': 0 = parallel... 1 = orthogonal
-		output += pow(1 - dot, 2);
-	}
-	return output;
-}
-float paintContext::lengthTerm(int index) {
-	float output = 0;
-	if (index > 0) output += pow(rays[index - 1].point().distanceTo(rays[index].point()),2);
-	if (index < rays.size() - 1) output += pow(rays[index + 1].point().distanceTo(rays[index].point()), 2);
-	return output;
-}
-float paintContext::errorTerm(int index) {
-	//find the mesh in the scene
-	MItDag itr(MItDag::kDepthFirst, MFn::kMesh);
-	MObject meshObj = itr.item();
-	MFnMesh mesh(meshObj);
-
-	MPoint actual, closest;
-	float output = 0;
-
-	//check the error for all level points, or the first point of fur/feather
-	if (mode == ModeType::LevelMode || index == 0) {
-		actual = rays[index].point();
-		mesh.getClosestPoint(actual, closest);
-		return pow(actual.distanceTo(closest) - startLevel - 0.001, 2);
-
-	//check error for last point of fur/feather (uses end level)
-	} else if (index == rays.size() - 1) {
-		actual = rays[index].point();
-		mesh.getClosestPoint(actual, closest);
-		output += pow(actual.distanceTo(closest) - endLevel, 2);
-	}
-	return output;
-}
-
-//Assess all three objective functions and weight each as prescribed in paper
-float paintContext::assessObj(int i) {
-
-	switch (mode) {
-	case ModeType::LevelMode:
-		return errorTerm(i) + angleTerm(i) * 0.1;
-	case ModeType::FeatherMode:
-	case ModeType::FurMode:
-		if (i == 0) return errorTerm(i); //root, must lie on desired level set for intelligibility
-		else return angleTerm(i) + lengthTerm(i) * 0.1; //interior fur/feather wont affect error, dont compute
-	default:
-		MGlobal::displayError("Unrecognized stroke type error");
-		return 0;
-	}
-}
-
-void paintContext::refinePoint(int i) {
-	float h = 0.001;
-	float gamma = 5;
-	float grad = 100;
-	float currentObj = 0;
-	//gradually decrease descent step size - recently changed from constant h and variable gamma coefficient
-	while (gamma > 0.01 && pow(grad,2) > 0.000000001) {
-		//finite difference to find the gradient
-		currentObj = assessObj(i);
-		rays[i].t += h;
-		grad = (assessObj(i) - currentObj); //moving t by h changes f(t) by grad
-		rays[i].t -= h; //return h to original value (for clarity)
-
-		//descent step
-		rays[i].t += gamma * -grad;
-		gamma -= 0.03;
-	}
-
-}
-
-void paintContext::initializeT(MFnMesh& mesh, PaintRay& r, bool end) {
-	float error = 10000;
-	float lastError = 10000;
-	float stepSize = 0;
-	MPoint closestPoint, thisPoint;
-	float oldDistance = 100;
-	float newDistance = 0;
-
-	//check if we can rely on a converging error
-	if (mesh.intersect(r.origin, r.direction, MPointArray())) {
-		while (true) {
-			thisPoint = r.point();
-			mesh.getClosestPoint(thisPoint, closestPoint);
-			error = thisPoint.distanceTo(closestPoint);
-			if (end) error -= endLevel;
-			else error -= startLevel;
-			if (error < kMaxError) break;
-			r.t += error;
-		}
-
-	} else {
-		//loops until closest point on ray is found (~linesearch)
-		while (oldDistance - newDistance > kMaxError) {
-			//get the oldDistance from the point
-			thisPoint = r.point();
-			mesh.getClosestPoint(thisPoint, closestPoint);
-			oldDistance = thisPoint.distanceTo(closestPoint);
-			stepSize = oldDistance / 3;
-			while (true) {
-				//create a newDistance by adding a step
-				thisPoint = r.point() + r.direction*stepSize;
-				mesh.getClosestPoint(thisPoint, closestPoint);
-				newDistance = thisPoint.distanceTo(closestPoint);
-				//if newDistance is better, repeat outer
-				if (newDistance - oldDistance < 0.005) {
-					r.t += stepSize;
-					break;
-				}
-				//otherwise reduce until newDistance is better or error is too small
-				stepSize /= 2;
-			}
-		}
-	}
+	input.unproject(x, y, newOrg, newDir);
+	lastFlush = seconds();
+	sampler.begin(x, y, lastFlush);
+	gestureX.assign(1, x);
+	gestureY.assign(1, y);
+
+	//beginning new line; the previous one may still be solving on its own copy
+	stroke.begin(session, &pool, strokeSettings());
+	FreeSpace prior;
+	depthCache.gather(session.sceneHandle(), prior);
+	stroke.setPrior(prior);
+	stroke.addRay(newOrg, newDir);
+	depthCache.record(session.sceneHandle(), stroke.firstRayTrace());
 }
 
-void paintContext::initializeCurve() {
-
-	MStatus s;
-
-	//get the mesh: works reliably only after freezing transforms
-	MItDag itr(MItDag::kDepthFirst, MFn::kMesh);
-	MObject meshObj = itr.item();
-	MFnMesh mesh(meshObj, &s);
+//The tool settings a stroke is solved with
+StrokeSettings paintContext::strokeSettings() const {
+	StrokeSettings settings;
+	settings.mode = mode;
+	settings.optimizer = optimizer;
+	settings.startLevel = startLevel;
+	settings.endLevel = endLevel;
+	settings.timeBudget = timeBudget / 1000.0;
+	settings.tolerance = tolerance;
+	settings.angleWeight = weight_a;
+	settings.lengthWeight = weight_l;
+	settings.errorWeight = weight_e;
+	return settings;
+}
 
-	if (s != MStatus::kSuccess) {
-		MGlobal::displayError("No mesh!");
-		return;
+//Positions are queued here and become rays a batch at a time, about once a frame, rather than
+//one at a time per event. A full ring is flushed on the spot; a batch left waiting when the
+//pen pauses is flushed from the idle callback (see onInputIdle)
+void paintContext::doDragCommon(MEvent & event)
+{
+	// Extract the event information
+	short x, y;
+	event.getPosition(x, y);
+	double now = seconds();
+	if (!input.push(x, y, now)) {
+		flushInput();
+		input.push(x, y, now);
 	}
+	if (now - lastFlush >= kInputInterval) flushInput();
+}
 
-	if (mode == LevelMode) {
-		//determine t values for every i
-		for (int i = 0; i < rays.size(); i++) {
-			initializeT(mesh, rays[i]);
-		}
-
-	//initialize hair or feathers
-	} else {
-		//determine t values for first and last i
-		initializeT(mesh, rays[0]);
-		initializeT(mesh, rays[rays.size() - 1], true);
-
-		//EXPERIMENTAL
-		//create an intersection plane on which to project the linearly initialize points
-		MPoint P = rays[rays.size() - 1].point();
-		MVector R = rays[rays.size() - 1].direction; //~eye to last
-		MVector D = rays[0].point() - P; //last to first
-		MVector planeNormal = D ^ (R^D); // Borrowing the 'minimum skew plane' from secondSkin: D x (R x D)
-
-		for (int i = 1; i < rays.size() - 1; i++) {
-			//typical plane intersection to linearly position internals
-			rays[i].t = ((P - rays[i].origin) * planeNormal)
-						/ (rays[i].direction * planeNormal);
-		}
+//The idle callback only lives while a stroke is drawn, since idle callbacks keep Maya spinning
+void paintContext::watchInput(bool watching) {
+	if (watching && !inputIdleRegistered) {
+		MStatus s;
+		inputIdle = MEventMessage::addEventCallback("idle", onInputIdle, this, &s);
+		inputIdleRegistered = s == MS::kSuccess;
+	} else if (!watching && inputIdleRegistered) {
+		MMessage::removeCallback(inputIdle);
+		inputIdleRegistered = false;
 	}
 }
 
-void paintContext::shapeCurve() {
-
+//No drag event comes while the pen rests, so a batch still queued after a frame is flushed here
+//and the view redrawn, which shows it through drawFeedback
+void paintContext::onInputIdle(void* clientData) {
+	paintContext* context = static_cast<paintContext*>(clientData);
+	if (context->input.pending() == 0 || seconds() - context->lastFlush < kInputInterval) return;
+	context->flushInput();
+	context->updatePreview(true);
+	context->view.refresh();
+}
 
-	//initial curve
-	//sendToMaya();
-	MGlobal::displayInfo("ITERATIVELY OPTIMIZING...........................");
-	//go through each ray, starting at the 'root' point, and optimize piecemeal
-	for (int i = 0; i < rays.size(); i++) {
-		refinePoint(i);
+//Samples the queued positions, unprojects the kept ones together and adds them to the stroke.
+//LevelMode rays are placed and refined as they are added (see StrokeSolver::addRay)
+void paintContext::flushInput()
+{
+	lastFlush = seconds();
+	std::vector<InputEvent> events;
+	input.drain(events);
+
+	std::vector<double> xs, ys;
+	for (size_t i = 0; i < events.size(); i++) {
+		if (!sampler.accept(events[i].x, events[i].y, events[i].time)) continue;
+		xs.push_back(events[i].x);
+		ys.push_back(events[i].y);
+		gestureX.push_back(events[i].x);
+		gestureY.push_back(events[i].y);
 	}
-	MGlobal::displayInfo("DONE OPTIMIZING..................................");
+	int n = (int)xs.size();
+	if (n == 0) return;
 
-	//final curve
-	sendToMaya();
+	std::vector<double> ox(n), oy(n), oz(n), dx(n), dy(n), dz(n);
+	input.unproject(n, &xs[0], &ys[0], &ox[0], &oy[0], &oz[0], &dx[0], &dy[0], &dz[0]);
+	for (int i = 0; i < n; i++) {
+		stroke.addRay(MPoint(ox[i], oy[i], oz[i]), MVector(dx[i], dy[i], dz[i]));
+	}
 }
 
 void paintContext::doReleaseCommon(MEvent & event)
 {
+	watchInput(false);
+	flushInput();
+
 	short x, y;
 	event.getPosition(x, y);
-	//see if the release was far enough away from the last point to warrant a ray
-	if (!sqrt(pow(lastx - x, 2) + pow(lasty - y, 2)) < 1.0 / DRAW_RESOLUTION) {
-
+	//the release ends the stroke unless it would only repeat the last ray
+	if (sampler.end(x, y)) {
 		MPoint newOrg = MPoint();
 		MVector newDir = MVector();
-		view.viewToWorld(x, y, newOrg, newDir);
+		input.unproject(x, y, newOrg, newDir);
 
-		rays.push_back(PaintRay(newOrg, newDir));
+		stroke.addRay(newOrg, newDir);
+		gestureX.push_back(x);
+		gestureY.push_back(y);
+	}
 
+	//begin creation of new curve; it is solved in the background and committed when Maya is
+	//idle, so the next stroke can start right away
+	if (mode != LevelMode && mode != FurMode && mode != FeatherMode) {
+		MGlobal::displayError("Unrecognized stroke type error");
+	} else if (stroke.isValid() && spray && mode == FurMode) {
+		MGlobal::displayInfo("ITERATIVELY OPTIMIZING...........................");
+		submitSpray();
+	} else if (stroke.isValid()) {
+		MGlobal::displayInfo("ITERATIVELY OPTIMIZING...........................");
+		queue.submit(std::move(stroke));
+	} else {
+		MGlobal::displayError("No mesh!");
 	}
+	session.end();
 
-	//begin creation of new curve
-	initializeCurve();
-	shapeCurve();
+	//earlier strokes solved during this one were held back until now
+	queue.setStrokeInProgress(false);
+	queue.commitFinished();
+}
+
+//Grows a strand from every spray root that lands on a mesh. Each strand follows the gesture,
+//shifted on screen by its root's offset from the press, and is built unplaced so the whole
+//batch is placed and refined on the pool. The gesture's own stroke only served the preview.
+void paintContext::submitSpray() {
+	StrokeSettings settings = strokeSettings();
+	//strands are refined one ray at a time, each on its own worker
+	settings.optimizer = PointwiseOptimizer;
+
+	//a random turn per gesture keeps repeated sprays from lining their roots up
+	double turn = std::uniform_real_distribution<double>(0, kFullTurn)(sprayRandom);
+
+	int n = (int)gestureX.size();
+	std::vector<double> xs(n), ys(n), ox(n), oy(n), oz(n), dx(n), dy(n), dz(n);
+	std::vector<StrokeSolver> strands;
+	strands.reserve(sprayCount);
+	for (int k = 0; k < sprayCount; k++) {
+		double radius = sprayRadius * std::sqrt((k + 0.5) / sprayCount);
+		double angle = turn + k * kGoldenAngle;
+		for (int i = 0; i < n; i++) {
+			xs[i] = gestureX[i] + radius * std::cos(angle);
+			ys[i] = gestureY[i] + radius * std::sin(angle);
+		}
+		input.unproject(n, &xs[0], &ys[0], &ox[0], &oy[0], &oz[0], &dx[0], &dy[0], &dz[0]);
+		if (!session.intersects(MPoint(ox[0], oy[0], oz[0]), MVector(dx[0], dy[0], dz[0]))) continue;
+
+		strands.push_back(StrokeSolver());
+		StrokeSolver& strand = strands.back();
+		strand.begin(session, 0, settings);
+		for (int i = 0; i < n; i++) strand.pushRay(MPoint(ox[i], oy[i], oz[i]), MVector(dx[i], dy[i], dz[i]));
+	}
+
+	if (strands.empty()) {
+		MGlobal::displayError("Easyl: no spray root landed on a mesh");
+		return;
+	}
+	queue.submit(std::move(strands));
+}
+
+//Called on the main thread, in release order, once a stroke or spray is solved
+void paintContext::commitStrokes(std::vector<StrokeSolver>& solved) {
+	int failed = 0, rays = 0, pushed = 0;
+	bool timedOut = false;
+	for (size_t i = 0; i < solved.size(); i++) {
+		failed += solved[i].failedCount();
+		pushed += solved[i].pushedCount();
+		rays += solved[i].rayBuffer().size();
+		timedOut = timedOut || solved[i].timedOut();
+	}
+	if (failed > 0) {
+		MGlobal::displayWarning(MString("Easyl: ") + failed + " of " + rays
+			+ " rays did not reach the level set within the iteration budget");
+	}
+	if (timedOut) {
+		MGlobal::displayInfo("Easyl: stopped optimizing at the time budget");
+	}
+	if (pushed > 0) {
+		MGlobal::displayInfo(MString("Easyl: pushed ") + pushed + " points that dipped into the mesh back out");
+	}
+	MGlobal::displayInfo("DONE OPTIMIZING..................................");
+
+	//final curves
+	sendToMaya(solved);
 }
 MStatus paintContext::doPress(MEvent & event)
 {
@@ -293,18 +315,7 @@ MStatus paintContext::doPress(MEvent & event)
 }
 MStatus paintContext::doDrag(MEvent & event)
 {
-	// Extract the event information
-	short x, y;
-	event.getPosition(x, y);
-	if (sqrt(pow(lastx - x, 2) + pow(lasty - y, 2)) < 1.0 / DRAW_RESOLUTION) return MS::kSuccess;
-
-	MPoint newOrg = MPoint();
-	MVector newDir = MVector();
-	view.viewToWorld(x, y, newOrg, newDir);
-
-	rays.push_back(PaintRay(newOrg, newDir));
-	lastx = x; lasty = y;
-
+	doDragCommon(event);
 	return MS::kSuccess;
 }
 MStatus paintContext::doRelease(MEvent & event)
@@ -318,43 +329,392 @@ MStatus	paintContext::doPress(MEvent & event, MHWRender::MUIDrawManager& drawMgr
 {
 	view = M3dView::active3dView();
 	doPressCommon(event);
+	updatePreview(true);
+	drawPreview(drawMgr);
 	return MS::kSuccess;
 }
 MStatus	paintContext::doRelease(MEvent & event, MHWRender::MUIDrawManager& drawMgr, const MHWRender::MFrameContext& context)
 {
 	doReleaseCommon(event);
+	//the stroke now belongs to the queue; its curve appears once solved
+	preview.clear();
 	return MS::kSuccess;
 }
+
+//Copies the stroke's current points into the preview, unless that was done less than a frame
+//ago. Rays placed during the drag show where they are; the rest (all but the root for fur and
+//feathers) are drawn at the root's depth until release places them.
+void paintContext::updatePreview(bool force) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (!force && std::chrono::duration<double>(now - lastPreview).count() < kPreviewInterval) return;
+	lastPreview = now;
+
+	const RayBuffer& rays = stroke.rayBuffer();
+	preview.setLength(rays.size());
+	float depth = rays.empty() ? 0 : rays.t[0];
+	for (int i = 0; i < rays.size(); i++) {
+		float t = i < stroke.initializedCount() ? rays.t[i] : depth;
+		preview[i] = rays.origin(i) + rays.direction(i) * t;
+	}
+}
+
+void paintContext::drawPreview(MHWRender::MUIDrawManager& drawMgr) {
+	if (preview.length() < 2) return;
+	drawMgr.beginDrawable();
+	drawMgr.setColor(MColor(1.0f, 0.8f, 0.2f));
+	drawMgr.setLineWidth(2.0f);
+	drawMgr.lineStrip(preview, false);
+	drawMgr.endDrawable();
+}
 MStatus	paintContext::doDrag(MEvent & event, MHWRender::MUIDrawManager& drawMgr, const MHWRender::MFrameContext& context)
 {
-	// Extract the event information
-	short x, y;
-	event.getPosition(x, y);
-	if (sqrt(pow(lastx - x, 2) + pow(lasty - y, 2)) < 1.0/DRAW_RESOLUTION) return MS::kSuccess;
+	doDragCommon(event);
+	//the cached line is drawn on every event, since VP2 drops what was drawn for the last one
+	updatePreview();
+	drawPreview(drawMgr);
+	return MS::kSuccess;
+}
 
-	MPoint newOrg = MPoint();
-	MVector newDir = MVector();
-	view.viewToWorld(x, y, newOrg, newDir);
+//Redraws of the view between drag events, such as the one onInputIdle asks for
+MStatus paintContext::drawFeedback(MHWRender::MUIDrawManager& drawMgr, const MHWRender::MFrameContext& context)
+{
+	drawPreview(drawMgr);
+	return MS::kSuccess;
+}
 
-	rays.push_back(PaintRay(newOrg, newDir));
-	lastx = x; lasty = y;
+//Creates every stroke's curve through one tool command (so a spray undoes in one step), then
+//converts them to paint effects the way the tool always has
+void paintContext::sendToMaya(const std::vector<StrokeSolver>& strokes) {
+	paintCurveCmd* cmd = (paintCurveCmd*)newToolCommand();
+	int points = 0, cvCount = 0;
+	double maxError = 0;
+	//the stroke each curve is made from
+	std::vector<size_t> drawn;
+	for (size_t i = 0; i < strokes.size(); i++) {
+		MPointArray cvs;
+		MDoubleArray knots;
+		int degree;
+		double error;
+		if (!curveFromRays(strokes[i].rayBuffer(), cvs, knots, degree, error)) continue;
+		cmd->addCurve(cvs, knots, degree);
+		drawn.push_back(i);
+		points += strokes[i].rayBuffer().size() - 1;
+		cvCount += cvs.length();
+		maxError = std::max(maxError, error);
+	}
+	//a click, or a stroke too short for a curve, leaves nothing to create
+	if (cmd->curveCount() == 0) return;
+	if (fitTolerance > 0) {
+		MGlobal::displayInfo(MString("Easyl: fitted ") + points + " points with " + cvCount
+			+ " cvs, max error " + maxError);
+	}
 
-	return MS::kSuccess;
+	if (cmd->redoIt() != MS::kSuccess) {
+		MGlobal::displayError("Easyl: could not create the stroke's curve");
+		return;
+	}
+	cmd->finalize();
+
+	const MObjectArray& created = cmd->curves();
+	std::vector<MObjectHandle> curves;
+	for (unsigned i = 0; i < created.length(); i++) curves.push_back(MObjectHandle(created[i]));
+	//fur strands guide interpolateFur for as long as their curves (or strokes) are in the scene
+	for (unsigned i = 0; i < created.length(); i++) {
+		if (strokes[drawn[i]].strokeMode() != FurMode) continue;
+		//the same points the strand's curve is made from
+		const RayBuffer& strand = strokes[drawn[i]].rayBuffer();
+		std::vector<Vec3> points;
+		for (int p = 0; p < strand.size() - 1; p++) points.push_back(toVec3(strand.point(p)));
+		if (fur.addGuide(points)) guideNodes.push_back(curves[i]);
+	}
+	if (batchConvert) {
+		pendingCurves.insert(pendingCurves.end(), curves.begin(), curves.end());
+		return;
+	}
+	convertCurves(curves);
 }
 
-void paintContext::sendToMaya() {
-	PaintRay r;
-	MString base = "string $theCurve = `curve -d 1";
-	for (int i = 0; i < rays.size()-1; i++) {
-		r = rays[i];
-		MPoint m = r.point();
-		base += " -p";
-		base += MString(" ") + m[0] + " " + m[1] + " " + m[2];
+//The curve through a solved stroke's points; false if it has too few to make one
+bool paintContext::curveFromRays(const RayBuffer& rays, MPointArray& cvs, MDoubleArray& knots, int& degree, double& error) {
+	degree = 1;
+	error = 0;
+	if (rays.size() < 3) return false;
+	if (fitTolerance > 0) {
+		//a cubic within tolerance of the optimized points needs far fewer cvs than one per ray
+		std::vector<Vec3> points(rays.size() - 1);
+		for (int i = 0; i < rays.size()-1; i++) {
+			points[i] = toVec3(rays.point(i));
+		}
+		CurveFit fit;
+		fitCubic(points, fitTolerance, fit);
+		degree = fit.degree;
+		error = fit.maxError;
+		cvs.setLength((unsigned)fit.cvs.size());
+		for (unsigned i = 0; i < cvs.length(); i++) cvs[i] = toMPoint(fit.cvs[i]);
+		for (size_t i = 0; i < fit.knots.size(); i++) knots.append(fit.knots[i]);
+	} else {
+		//one cv per ray, one knot per cv
+		cvs.setLength(rays.size() - 1);
+		for (int i = 0; i < rays.size()-1; i++) {
+			cvs[i] = rays.point(i);
+			knots.append(i);
+		}
 	}
-	base += "`;";
-	MGlobal::executeCommand(base);
+	return true;
+}
+
+//Attaches the brush to every curve still in the scene and converts them to paint effects in one
+//go, refreshing the UI once, then deletes the curves
+void paintContext::convertCurves(const std::vector<MObjectHandle>& curves) {
+	MSelectionList selection;
+	MString names;
+	std::vector<MObjectHandle> converted;
+	for (size_t i = 0; i < curves.size(); i++) {
+		//the artist may have deleted some of them (or undone their strokes) since
+		if (!curves[i].isValid() || !curves[i].isAlive()) continue;
+		selection.add(curves[i].object());
+		converted.push_back(curves[i]);
+		names += " " + MFnDagNode(curves[i].object()).fullPathName();
+	}
+	if (selection.length() == 0) return;
+
+	//conversion works on the selection; the artist's own is put back afterwards
+	MSelectionList artistSelection;
+	MGlobal::getActiveSelectionList(artistSelection);
+	MGlobal::setActiveSelectionList(selection, MGlobal::kReplaceList);
 	MGlobal::executeCommand("AttachBrushToCurves;convertCurvesToStrokes;manipMoveValues Move;toolPropertyShow;autoUpdateAttrEd;");
-	MGlobal::executeCommand("delete $theCurve;");
+	followConversion(converted);
+	MGlobal::executeCommand("delete" + names + ";");
+	MGlobal::setActiveSelectionList(artistSelection, MGlobal::kReplaceList);
+}
+
+//The paint effects stroke made from curve, found through its shape's world space output; a
+//null object if conversion left none
+static MObject strokeFromCurve(const MObject& curve) {
+	MFnDagNode transform(curve);
+	for (unsigned c = 0; c < transform.childCount(); c++) {
+		MPlug worldSpace = MFnDagNode(transform.child(c)).findPlug("worldSpace", true);
+		for (unsigned e = 0; e < worldSpace.numElements(); e++) {
+			MPlugArray targets;
+			worldSpace[e].connectedTo(targets, false, true);
+			for (unsigned t = 0; t < targets.length(); t++) {
+				MObject node = targets[t].node();
+				if (node.hasFn(MFn::kStroke)) return MFnDagNode(node).parent(0);
+			}
+		}
+	}
+	return MObject::kNullObj;
+}
+
+//Guides drawn as one of the converted curves follow the stroke made from it, since the curve
+//itself is deleted next
+void paintContext::followConversion(const std::vector<MObjectHandle>& converted) {
+	if (guideNodes.empty()) return;
+	typedef std::unordered_multimap<unsigned, size_t> HandleIndex;
+	HandleIndex byHash;
+	for (size_t i = 0; i < converted.size(); i++) byHash.insert(std::make_pair(converted[i].hashCode(), i));
+	for (size_t g = 0; g < guideNodes.size(); g++) {
+		std::pair<HandleIndex::iterator, HandleIndex::iterator> range = byHash.equal_range(guideNodes[g].hashCode());
+		for (HandleIndex::iterator it = range.first; it != range.second; ++it) {
+			if (!(converted[it->second] == guideNodes[g])) continue;
+			MObject stroke = strokeFromCurve(converted[it->second].object());
+			if (!stroke.isNull()) guideNodes[g] = MObjectHandle(stroke);
+			break;
+		}
+	}
+}
+
+//Drops the guides whose curve or stroke has been deleted or undone since it was drawn
+void paintContext::pruneGuides() {
+	std::vector<char> keep(guideNodes.size());
+	size_t kept = 0;
+	for (size_t g = 0; g < guideNodes.size(); g++) {
+		keep[g] = guideNodes[g].isValid() && guideNodes[g].isAlive();
+		if (keep[g]) guideNodes[kept++] = guideNodes[g];
+	}
+	guideNodes.resize(kept);
+	fur.keepGuides(keep);
+}
+
+//Guides whose curve or stroke is still in the scene; pruneGuides drops the rest when they are used
+int paintContext::getGuideCount() const {
+	int count = 0;
+	for (size_t g = 0; g < guideNodes.size(); g++) {
+		if (guideNodes[g].isValid() && guideNodes[g].isAlive()) count++;
+	}
+	return count;
+}
+
+//Grows childCount children at random over the surface around the guides
+void paintContext::interpolateFur() {
+	//strands still solving become guides too
+	queue.finish();
+	pruneGuides();
+	if (fur.guideCount() == 0) {
+		MGlobal::displayError("Easyl: draw some fur first; its strands guide the interpolation");
+		return;
+	}
+	if (session.begin() != MS::kSuccess) {
+		MGlobal::displayError("No mesh!");
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int grown = fur.interpolate(session.sceneBVH(), furCurveCount(), childRadius, pool);
+	session.end();
+	if (grown > 0 && !createFurCurves(grown)) return;
+	double milliseconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+	MGlobal::displayInfo(MString("Easyl: interpolated ") + grown + " strands of " + fur.pointsPerStrand()
+		+ " points from " + fur.guideCount() + " guides (radius " + fur.searchRadius() + ") and created their curves in "
+		+ milliseconds + " ms, " + (double)fur.memoryBytes() / (1024.0 * 1024.0) + " MB");
+}
+
+//World space triangles of the mesh at path that have a guide in reach, with the UVs of their
+//corners when the mesh has any
+static void addFurSurface(const MDagPath& path, const FurInterpolator& fur, ThreadPool& pool, FurScatter& scatter) {
+	MStatus s;
+	MFnMesh fnMesh(path, &s);
+	if (s != MStatus::kSuccess) return;
+	MPointArray points;
+	MIntArray vertexCount, vertexList, triangleCounts, triangleCorners, uvCounts, uvIds;
+	MFloatArray us, vs;
+	fnMesh.getPoints(points, MSpace::kWorld);
+	fnMesh.getVertices(vertexCount, vertexList);
+	//triangle corners as positions within their face, which index the face's UVs too
+	fnMesh.getTriangleOffsets(triangleCounts, triangleCorners);
+	fnMesh.getAssignedUVs(uvCounts, uvIds);
+	fnMesh.getUVs(us, vs);
+
+	std::vector<Vec3> vertices(points.length());
+	for (unsigned i = 0; i < points.length(); i++) vertices[i] = toVec3(points[i]);
+	bool mapped = uvIds.length() > 0;
+	std::vector<int> triangles;
+	std::vector<float> uvs;
+	//faces without UVs on a partly mapped mesh stay at full density
+	std::vector<char> triangleMapped;
+	unsigned faceStart = 0, uvStart = 0, corner = 0;
+	for (unsigned p = 0; p < vertexCount.length(); p++) {
+		bool faceMapped = mapped && uvCounts[p] == vertexCount[p];
+		for (int t = 0; t < triangleCounts[p]; t++) {
+			if (mapped) triangleMapped.push_back(faceMapped ? 1 : 0);
+			for (int k = 0; k < 3; k++, corner++) {
+				int local = triangleCorners[corner];
+				triangles.push_back(vertexList[faceStart + local]);
+				if (!mapped) continue;
+				uvs.push_back(faceMapped ? us[uvIds[uvStart + local]] : 0.0f);
+				uvs.push_back(faceMapped ? vs[uvIds[uvStart + local]] : 0.0f);
+			}
+		}
+		faceStart += vertexCount[p];
+		uvStart += uvCounts[p];
+	}
+
+	//children rooted out of reach of every guide would be dropped, so don't scatter there
+	int count = (int)triangles.size() / 3;
+	std::vector<char> reached(count);
+	pool.parallelFor(count, [&](int t) {
+		const int* v = &triangles[3 * t];
+		reached[t] = fur.covers((vertices[v[0]] + vertices[v[1]] + vertices[v[2]]) / 3);
+	}, 1024);
+	int kept = 0;
+	for (int t = 0; t < count; t++) {
+		if (!reached[t]) continue;
+		std::copy(triangles.begin() + 3 * t, triangles.begin() + 3 * t + 3, triangles.begin() + 3 * kept);
+		if (mapped) {
+			std::copy(uvs.begin() + 6 * t, uvs.begin() + 6 * t + 6, uvs.begin() + 6 * kept);
+			triangleMapped[kept] = triangleMapped[t];
+		}
+		kept++;
+	}
+	triangles.resize(3 * kept);
+	uvs.resize(mapped ? 6 * kept : 0);
+	triangleMapped.resize(mapped ? kept : 0);
+	scatter.addTriangles(vertices, triangles, uvs, triangleMapped);
+}
+
+//Grows childCount children like interpolateFur, but roots them at blue noise points over the
+//meshes under the guides, no closer than scatterSpacing and thinned by the density map
+void paintContext::scatterFur() {
+	queue.finish();
+	pruneGuides();
+	if (fur.guideCount() == 0) {
+		MGlobal::displayError("Easyl: draw some fur first; its strands guide the interpolation");
+		return;
+	}
+	if (session.begin() != MS::kSuccess) {
+		MGlobal::displayError("No mesh!");
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	FurScatter scatter;
+	if (densityMap.length() > 0 && !scatter.loadDensityMap(densityMap.asChar())) {
+		MGlobal::displayWarning(MString("Easyl: could not read the density map ") + densityMap + "; scattering evenly");
+	}
+	int grown = 0;
+	if (fur.prepare(session.sceneBVH(), childRadius)) {
+		for (int m = 0; m < session.meshCount(); m++) addFurSurface(session.meshPath(m), fur, pool, scatter);
+		scatter.scatter(furCurveCount(), scatterSpacing, pool);
+		grown = fur.interpolate(session.sceneBVH(), scatter.roots(), scatter.normals(), childRadius, pool);
+	}
+	session.end();
+	if (grown > 0 && !createFurCurves(grown)) return;
+	double milliseconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+	MGlobal::displayInfo(MString("Easyl: scattered ") + (int)scatter.roots().size() + " roots "
+		+ scatter.spacingUsed() + " apart over " + scatter.triangleCount() + " triangles from "
+		+ scatter.candidateCount() + " candidates, grew " + grown + " strands from " + fur.guideCount()
+		+ " guides and created their curves in " + milliseconds + " ms, "
+		+ (double)(scatter.memoryBytes() + fur.memoryBytes()) / (1024.0 * 1024.0) + " MB");
+}
+
+//childCount, held to kMaxFurCurves
+int paintContext::furCurveCount() const {
+	if (childCount <= kMaxFurCurves) return childCount;
+	MGlobal::displayWarning(MString("Easyl: growing ") + kMaxFurCurves + " of the " + childCount
+		+ " strands asked for; more curves than that make the scene and its undo too heavy");
+	return kMaxFurCurves;
+}
+
+//The strands fur last grew, as cubic curves created in one undoable step and grouped under one
+//transform. They are left as plain curves, ready for a hair system; converting that many to
+//paint effects is not worth it.
+bool paintContext::createFurCurves(int strands) {
+	//clamped uniform knots for a cubic through the strand's points
+	int perStrand = fur.pointsPerStrand();
+	int degree = std::min(3, perStrand - 1);
+	MDoubleArray knots;
+	for (int k = 0; k < perStrand + degree - 1; k++) {
+		knots.append(std::min(std::max(k - degree + 1, 0), perStrand - degree));
+	}
+
+	paintCurveCmd* cmd = (paintCurveCmd*)newToolCommand();
+	cmd->setGroup("easylFur");
+	MPointArray cvs(perStrand);
+	for (int c = 0; c < strands; c++) {
+		for (int j = 0; j < perStrand; j++) {
+			size_t at = (size_t)c * perStrand + j;
+			cvs[j] = MPoint(fur.x()[at], fur.y()[at], fur.z()[at]);
+		}
+		cmd->addCurve(cvs, knots, degree);
+	}
+	if (cmd->redoIt() != MS::kSuccess) {
+		MGlobal::displayError("Easyl: could not create the interpolated fur");
+		return false;
+	}
+	cmd->finalize();
+	return true;
+}
+
+void paintContext::clearGuides() {
+	fur.clearGuides();
+	guideNodes.clear();
+}
+
+//Converts every curve queued in batch mode
+void paintContext::convertPending() {
+	std::vector<MObjectHandle> curves;
+	curves.swap(pendingCurves);
+	convertCurves(curves);
 }
 
 void paintContext::setStartLevel(float theLevel) {
@@ -366,4 +726,74 @@ void paintContext::setEndLevel(float level) {
 void paintContext::setMode(int modeInt) {
 	mode = static_cast<ModeType>(modeInt);
 }
-
+void paintContext::setDistanceField(bool enabled) {
+	useDistanceField = enabled;
+}
+void paintContext::setVoxelSize(float size) {
+	voxelSize = size;
+}
+void paintContext::setNarrowBand(float band) {
+	narrowBand = band;
+}
+void paintContext::setOptimizer(int optimizerInt) {
+	optimizer = static_cast<OptimizerType>(std::min(std::max(optimizerInt, (int)PointwiseOptimizer), (int)ParallelOptimizer));
+}
+void paintContext::setFitTolerance(float tolerance) {
+	fitTolerance = tolerance;
+}
+void paintContext::setMinSpacing(float pixels) {
+	sampler.setSpacing(pixels, sampler.maxSpacing());
+}
+void paintContext::setMaxSpacing(float pixels) {
+	sampler.setSpacing(sampler.minSpacing(), pixels);
+}
+void paintContext::setSampleTolerance(float pixels) {
+	sampler.setTolerance(pixels);
+}
+void paintContext::setRayBudget(int rays) {
+	sampler.setBudget(rays);
+}
+void paintContext::setBatchConvert(bool enabled) {
+	batchConvert = enabled;
+	if (!enabled) convertPending();
+}
+void paintContext::setTimeBudget(float milliseconds) {
+	timeBudget = std::max(0.0f, milliseconds);
+}
+void paintContext::setTolerance(float theTolerance) {
+	tolerance = std::max(0.0f, theTolerance);
+}
+void paintContext::setAngleWeight(float weight) {
+	weight_a = std::max(0.0f, weight);
+}
+void paintContext::setLengthWeight(float weight) {
+	weight_l = std::max(0.0f, weight);
+}
+void paintContext::setErrorWeight(float weight) {
+	weight_e = std::max(0.0f, weight);
+}
+void paintContext::setSpray(bool enabled) {
+	spray = enabled;
+}
+void paintContext::setSprayCount(int strands) {
+	sprayCount = std::max(1, strands);
+}
+void paintContext::setSprayRadius(float pixels) {
+	sprayRadius = std::max(0.0f, pixels);
+}
+void paintContext::setChildCount(int strands) {
+	childCount = std::max(0, strands);
+}
+void paintContext::setChildRadius(float radius) {
+	childRadius = std::max(0.0f, radius);
+}
+void paintContext::setDensityMap(const MString& file) {
+	densityMap = file;
+}
+void paintContext::setScatterSpacing(float spacing) {
+	scatterSpacing = std::max(0.0f, spacing);
+}
+void paintContext::setThreadCount(int count) {
+	threadCount = count;
+	pool.setThreadCount(count);
+}
\ No newline at end of file
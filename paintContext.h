@@ -6,27 +6,25 @@
 #include <maya\MPoint.h>
 #include <maya\MVector.h>
 #include <maya\M3dView.h>
-
-class PaintRay {
-public:
-	MPoint origin;
-	MVector direction;
-	float t;
-
-	PaintRay() { } //shouldn't be called
-	PaintRay(MPoint o, MVector d) {
-		origin = o; direction = d; t = 0;
-	}
-	MPoint point() { return origin + t*direction; }
-};
-
-enum ModeType {ErrorMode,LevelMode,FurMode,FeatherMode};
+#include <maya\MPointArray.h>
+#include <maya\MUIDrawManager.h>
+#include <maya\MObjectHandle.h>
+#include <chrono>
+#include <random>
+#include "strokeSession.h"
+#include "strokeSolver.h"
+#include "solveQueue.h"
+#include "threadPool.h"
+#include "strokeSampler.h"
+#include "strokeInput.h"
+#include "furInterpolator.h"
 
 class paintContext : public MPxContext
 {
 public:
 	paintContext();
 	virtual void	toolOnSetup(MEvent & event);
+	virtual void	toolOffCleanup();
 	void getClassName(MString &name) const;
 
 	// Catch-all methods for use in any viewport renderer - each will be routed to their 'common' method
@@ -36,40 +34,160 @@ public:
 	virtual MStatus	doPress(MEvent & event, MHWRender::MUIDrawManager& drawMgr, const MHWRender::MFrameContext& context);
 	virtual MStatus	doRelease(MEvent & event, MHWRender::MUIDrawManager& drawMgr, const MHWRender::MFrameContext& context);
 	virtual MStatus	doDrag(MEvent & event, MHWRender::MUIDrawManager& drawMgr, const MHWRender::MFrameContext& context);
+	virtual MStatus	drawFeedback(MHWRender::MUIDrawManager& drawMgr, const MHWRender::MFrameContext& context);
 
 	//tool Settings methods - set
 	void setStartLevel(float level);
 	void setEndLevel(float level);
 	void setMode(int modeInt);
+	void setDistanceField(bool enabled);
+	void setVoxelSize(float size);
+	void setNarrowBand(float band);
+	void setOptimizer(int optimizerInt);
+	void setThreadCount(int count);
+	void setFitTolerance(float tolerance);
+	void setMinSpacing(float pixels);
+	void setMaxSpacing(float pixels);
+	void setSampleTolerance(float pixels);
+	void setRayBudget(int rays);
+	void setBatchConvert(bool enabled);
+	void setTimeBudget(float milliseconds);
+	void setTolerance(float tolerance);
+	void setAngleWeight(float weight);
+	void setLengthWeight(float weight);
+	void setErrorWeight(float weight);
+	void setSpray(bool enabled);
+	void setSprayCount(int strands);
+	void setSprayRadius(float pixels);
+	void setChildCount(int strands);
+	void setChildRadius(float radius);
+	void setDensityMap(const MString& file);
+	void setScatterSpacing(float spacing);
+	//paint effects conversion of every curve queued in batch mode
+	void convertPending();
+	//grows dense fur from the fur strokes drawn so far, or forgets them
+	void interpolateFur();
+	//the same, with roots spread as blue noise and thinned by the density map
+	void scatterFur();
+	void clearGuides();
 	//get
 	float getStartLevel() { return startLevel; };
 	float getEndLevel() { return endLevel; };
 	int getMode() { return (int)mode; };
+	int getOptimizer() { return (int)optimizer; };
+	int getThreadCount() { return threadCount; };
+	bool getDistanceField() { return useDistanceField; };
+	float getVoxelSize() { return voxelSize; };
+	float getNarrowBand() { return narrowBand; };
+	float getFitTolerance() { return fitTolerance; };
+	float getMinSpacing() { return sampler.minSpacing(); };
+	float getMaxSpacing() { return sampler.maxSpacing(); };
+	float getSampleTolerance() { return sampler.tolerance(); };
+	int getRayBudget() { return sampler.budget(); };
+	bool getBatchConvert() { return batchConvert; };
+	int getPendingCurves() { return (int)pendingCurves.size(); };
+	float getTimeBudget() { return timeBudget; };
+	float getTolerance() { return tolerance; };
+	float getAngleWeight() { return weight_a; };
+	float getLengthWeight() { return weight_l; };
+	float getErrorWeight() { return weight_e; };
+	bool getSpray() { return spray; };
+	int getSprayCount() { return sprayCount; };
+	float getSprayRadius() { return sprayRadius; };
+	int getChildCount() { return childCount; };
+	float getChildRadius() { return childRadius; };
+	int getGuideCount() const;
+	MString getDensityMap() { return densityMap; };
+	float getScatterSpacing() { return scatterSpacing; };
+	float getDistanceFieldMemory() { return session.distanceFieldMemory() / (1024.0f * 1024.0f); };
 
 
 private:
-	// Press and Release shared operations (agnostic of viewport)
+	// Press, Drag and Release shared operations (agnostic of viewport)
 	void doPressCommon(MEvent & event);
+	void doDragCommon(MEvent & event);
 	void doReleaseCommon(MEvent & event);
-	void initializeCurve();
-	void initializeT(MFnMesh& mesh, PaintRay& r, bool end = false);
-	float angleTerm(int i);
-	float lengthTerm(int i );
-	float errorTerm(int i);
-	void shapeCurve();
-	void sendToMaya();
+	void flushInput();
+	void watchInput(bool watching);
+	static void onInputIdle(void* clientData);
+	StrokeSettings strokeSettings() const;
+	void submitSpray();
+	void commitStrokes(std::vector<StrokeSolver>& solved);
+	void sendToMaya(const std::vector<StrokeSolver>& strokes);
+	bool curveFromRays(const RayBuffer& rays, MPointArray& cvs, MDoubleArray& knots, int& degree, double& error);
+	void convertCurves(const std::vector<MObjectHandle>& curves);
+	void followConversion(const std::vector<MObjectHandle>& converted);
+	void pruneGuides();
+	int furCurveCount() const;
+	bool createFurCurves(int strands);
+	void updatePreview(bool force = false);
+	void drawPreview(MHWRender::MUIDrawManager& drawMgr);
 
-	// Temporary vector abstractions
-	std::vector<PaintRay> rays;
+	// the stroke being drawn; handed to the queue at release
+	StrokeSolver stroke;
 
-	//Screen locations to detect movement threshold
-	short lastx, lasty, threshold;
+	//movement threshold
+	short threshold;
+	//drag positions not yet handled, and the view they are unprojected through
+	StrokeInput input;
+	double lastFlush;
+	//flushes a batch left queued while the pen rests; registered from press to release
+	MCallbackId inputIdle;
+	bool inputIdleRegistered;
+	//picks which drag positions become rays
+	StrokeSampler sampler;
+	//screen positions of every ray of the stroke, which a fur spray offsets once per strand
+	std::vector<double> gestureX, gestureY;
 	float startLevel, endLevel;
 	ModeType mode;
+	OptimizerType optimizer;
+	//multipliers on the angle, length and level set error terms
 	float weight_a, weight_l, weight_e;
-	float assessObj(int i);
-	void refinePoint(int i);
+	//milliseconds a stroke's solve may take (0 for no limit), and when it counts as converged
+	float timeBudget, tolerance;
+	bool useDistanceField;
+	float voxelSize, narrowBand;
+	//fur spray: one gesture grows sprayCount strands from roots within sprayRadius pixels
+	bool spray;
+	int sprayCount;
+	float sprayRadius;
+	//turns each spray's roots; one per tool, so a session's sprays repeat from the same start
+	std::mt19937 sprayRandom;
+	//every solved fur strand still in the scene guides interpolateFur, which grows childCount
+	//children (at most kMaxFurCurves) blended from the guides within childRadius (0 picks one
+	//from their spacing)
+	FurInterpolator fur;
+	//per guide, the curve drawn for it or the paint effects stroke that curve became
+	std::vector<MObjectHandle> guideNodes;
+	int childCount;
+	float childRadius;
+	//scatterFur roots: a greyscale .bmp over UV space ("" for even density) and the least
+	//distance between them (0 picks one from childCount)
+	MString densityMap;
+	float scatterSpacing;
+	//largest distance allowed between the stroke and its fitted cubic; 0 keeps one cv per ray
+	float fitTolerance;
+	//batch mode keeps finished curves for one paint effects conversion at flush or tool exit
+	bool batchConvert;
+	std::vector<MObjectHandle> pendingCurves;
 
 	// screen space object
 	M3dView view;
+
+	// VP2 preview of the stroke so far, rebuilt at most once a frame
+	MPointArray preview;
+	std::chrono::steady_clock::time_point lastPreview;
+
+	// mesh queries for the stroke in progress, resolved at press
+	StrokeSession session;
+	// free space traced by the first rays of recent strokes, to start the next one part way
+	DepthCache depthCache;
+
+	// workers for per-ray work; 0 threads means one per core
+	ThreadPool pool;
+	int threadCount;
+
+	// released strokes being solved in the background; declared last so its worker stops
+	// before anything it uses goes away
+	SolveQueue queue;
 };
\ No newline at end of file
@@ -7,6 +7,66 @@
 #define kEndingLevelSetFlagLong "-endLevel"
 #define kModeFlag "-m"
 #define kModeFlagLong "-mode"
+#define kOptimizerFlag "-opt"
+#define kOptimizerFlagLong "-optimizer"
+#define kThreadCountFlag "-th"
+#define kThreadCountFlagLong "-threads"
+#define kDistanceFieldFlag "-sdf"
+#define kDistanceFieldFlagLong "-distanceField"
+#define kVoxelSizeFlag "-vs"
+#define kVoxelSizeFlagLong "-voxelSize"
+#define kNarrowBandFlag "-nb"
+#define kNarrowBandFlagLong "-narrowBand"
+#define kFieldMemoryFlag "-sdm"
+#define kFieldMemoryFlagLong "-distanceFieldMemory"
+#define kFitToleranceFlag "-ft"
+#define kFitToleranceFlagLong "-fitTolerance"
+#define kMinSpacingFlag "-mns"
+#define kMinSpacingFlagLong "-minSpacing"
+#define kMaxSpacingFlag "-mxs"
+#define kMaxSpacingFlagLong "-maxSpacing"
+#define kSampleToleranceFlag "-stl"
+#define kSampleToleranceFlagLong "-sampleTolerance"
+#define kRayBudgetFlag "-rb"
+#define kRayBudgetFlagLong "-rayBudget"
+#define kBatchConvertFlag "-bc"
+#define kBatchConvertFlagLong "-batchConvert"
+#define kPendingCurvesFlag "-pc"
+#define kPendingCurvesFlagLong "-pendingCurves"
+#define kFlushFlag "-fl"
+#define kFlushFlagLong "-flush"
+#define kTimeBudgetFlag "-tb"
+#define kTimeBudgetFlagLong "-timeBudget"
+#define kToleranceFlag "-tol"
+#define kToleranceFlagLong "-tolerance"
+#define kAngleWeightFlag "-wa"
+#define kAngleWeightFlagLong "-angleWeight"
+#define kLengthWeightFlag "-wl"
+#define kLengthWeightFlagLong "-lengthWeight"
+#define kErrorWeightFlag "-we"
+#define kErrorWeightFlagLong "-errorWeight"
+#define kSprayFlag "-spr"
+#define kSprayFlagLong "-spray"
+#define kSprayCountFlag "-sc"
+#define kSprayCountFlagLong "-sprayCount"
+#define kSprayRadiusFlag "-sr"
+#define kSprayRadiusFlagLong "-sprayRadius"
+#define kChildCountFlag "-chc"
+#define kChildCountFlagLong "-childCount"
+#define kChildRadiusFlag "-chr"
+#define kChildRadiusFlagLong "-childRadius"
+#define kGuideCountFlag "-gdc"
+#define kGuideCountFlagLong "-guideCount"
+#define kInterpolateFurFlag "-ifr"
+#define kInterpolateFurFlagLong "-interpolateFur"
+#define kClearGuidesFlag "-clg"
+#define kClearGuidesFlagLong "-clearGuides"
+#define kDensityMapFlag "-dmp"
+#define kDensityMapFlagLong "-densityMap"
+#define kScatterSpacingFlag "-ssp"
+#define kScatterSpacingFlagLong "-scatterSpacing"
+#define kScatterFurFlag "-scf"
+#define kScatterFurFlagLong "-scatterFur"
 
 paintContextCmd::paintContextCmd() {}
 
@@ -59,6 +119,254 @@ MStatus paintContextCmd::doEditFlags()
 		fPaintContext->setMode(newMode);
 	}
 
+	if (argData.isFlagSet(kOptimizerFlag)) {
+		int newOptimizer;
+		status = argData.getFlagArgument(kOptimizerFlag, 0, newOptimizer);
+		if (!status) {
+			status.perror("optimizer flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setOptimizer(newOptimizer);
+	}
+
+	if (argData.isFlagSet(kThreadCountFlag)) {
+		int count;
+		status = argData.getFlagArgument(kThreadCountFlag, 0, count);
+		if (!status) {
+			status.perror("thread count flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setThreadCount(count);
+	}
+
+	if (argData.isFlagSet(kDistanceFieldFlag)) {
+		bool enabled;
+		status = argData.getFlagArgument(kDistanceFieldFlag, 0, enabled);
+		if (!status) {
+			status.perror("distance field flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setDistanceField(enabled);
+	}
+
+	if (argData.isFlagSet(kVoxelSizeFlag)) {
+		double size;
+		status = argData.getFlagArgument(kVoxelSizeFlag, 0, size);
+		if (!status) {
+			status.perror("voxel size flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setVoxelSize(size);
+	}
+
+	if (argData.isFlagSet(kNarrowBandFlag)) {
+		double band;
+		status = argData.getFlagArgument(kNarrowBandFlag, 0, band);
+		if (!status) {
+			status.perror("narrow band flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setNarrowBand(band);
+	}
+
+	if (argData.isFlagSet(kFitToleranceFlag)) {
+		double tolerance;
+		status = argData.getFlagArgument(kFitToleranceFlag, 0, tolerance);
+		if (!status) {
+			status.perror("fit tolerance flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setFitTolerance(tolerance);
+	}
+
+	if (argData.isFlagSet(kMinSpacingFlag)) {
+		double pixels;
+		status = argData.getFlagArgument(kMinSpacingFlag, 0, pixels);
+		if (!status) {
+			status.perror("min spacing flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setMinSpacing(pixels);
+	}
+
+	if (argData.isFlagSet(kMaxSpacingFlag)) {
+		double pixels;
+		status = argData.getFlagArgument(kMaxSpacingFlag, 0, pixels);
+		if (!status) {
+			status.perror("max spacing flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setMaxSpacing(pixels);
+	}
+
+	if (argData.isFlagSet(kSampleToleranceFlag)) {
+		double pixels;
+		status = argData.getFlagArgument(kSampleToleranceFlag, 0, pixels);
+		if (!status) {
+			status.perror("sample tolerance flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setSampleTolerance(pixels);
+	}
+
+	if (argData.isFlagSet(kRayBudgetFlag)) {
+		int rays;
+		status = argData.getFlagArgument(kRayBudgetFlag, 0, rays);
+		if (!status) {
+			status.perror("ray budget flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setRayBudget(rays);
+	}
+
+	if (argData.isFlagSet(kBatchConvertFlag)) {
+		bool enabled;
+		status = argData.getFlagArgument(kBatchConvertFlag, 0, enabled);
+		if (!status) {
+			status.perror("batch convert flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setBatchConvert(enabled);
+	}
+
+	//convert everything queued in batch mode now
+	if (argData.isFlagSet(kFlushFlag)) {
+		fPaintContext->convertPending();
+	}
+
+	if (argData.isFlagSet(kTimeBudgetFlag)) {
+		double milliseconds;
+		status = argData.getFlagArgument(kTimeBudgetFlag, 0, milliseconds);
+		if (!status) {
+			status.perror("time budget flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setTimeBudget(milliseconds);
+	}
+
+	if (argData.isFlagSet(kToleranceFlag)) {
+		double tolerance;
+		status = argData.getFlagArgument(kToleranceFlag, 0, tolerance);
+		if (!status) {
+			status.perror("tolerance flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setTolerance(tolerance);
+	}
+
+	if (argData.isFlagSet(kAngleWeightFlag)) {
+		double weight;
+		status = argData.getFlagArgument(kAngleWeightFlag, 0, weight);
+		if (!status) {
+			status.perror("angle weight flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setAngleWeight(weight);
+	}
+
+	if (argData.isFlagSet(kLengthWeightFlag)) {
+		double weight;
+		status = argData.getFlagArgument(kLengthWeightFlag, 0, weight);
+		if (!status) {
+			status.perror("length weight flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setLengthWeight(weight);
+	}
+
+	if (argData.isFlagSet(kErrorWeightFlag)) {
+		double weight;
+		status = argData.getFlagArgument(kErrorWeightFlag, 0, weight);
+		if (!status) {
+			status.perror("error weight flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setErrorWeight(weight);
+	}
+
+	if (argData.isFlagSet(kSprayFlag)) {
+		bool enabled;
+		status = argData.getFlagArgument(kSprayFlag, 0, enabled);
+		if (!status) {
+			status.perror("spray flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setSpray(enabled);
+	}
+
+	if (argData.isFlagSet(kSprayCountFlag)) {
+		int strands;
+		status = argData.getFlagArgument(kSprayCountFlag, 0, strands);
+		if (!status) {
+			status.perror("spray count flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setSprayCount(strands);
+	}
+
+	if (argData.isFlagSet(kSprayRadiusFlag)) {
+		double pixels;
+		status = argData.getFlagArgument(kSprayRadiusFlag, 0, pixels);
+		if (!status) {
+			status.perror("spray radius flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setSprayRadius(pixels);
+	}
+
+	if (argData.isFlagSet(kChildCountFlag)) {
+		int strands;
+		status = argData.getFlagArgument(kChildCountFlag, 0, strands);
+		if (!status) {
+			status.perror("child count flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setChildCount(strands);
+	}
+
+	if (argData.isFlagSet(kChildRadiusFlag)) {
+		double radius;
+		status = argData.getFlagArgument(kChildRadiusFlag, 0, radius);
+		if (!status) {
+			status.perror("child radius flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setChildRadius(radius);
+	}
+
+	if (argData.isFlagSet(kDensityMapFlag)) {
+		MString file;
+		status = argData.getFlagArgument(kDensityMapFlag, 0, file);
+		if (!status) {
+			status.perror("density map flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setDensityMap(file);
+	}
+
+	if (argData.isFlagSet(kScatterSpacingFlag)) {
+		double spacing;
+		status = argData.getFlagArgument(kScatterSpacingFlag, 0, spacing);
+		if (!status) {
+			status.perror("scatter spacing flag parsing failed.");
+			return status;
+		}
+		fPaintContext->setScatterSpacing(spacing);
+	}
+
+	//grow children from the guides now; after the settings above so they apply
+	if (argData.isFlagSet(kInterpolateFurFlag)) {
+		fPaintContext->interpolateFur();
+	}
+
+	if (argData.isFlagSet(kScatterFurFlag)) {
+		fPaintContext->scatterFur();
+	}
+
+	if (argData.isFlagSet(kClearGuidesFlag)) {
+		fPaintContext->clearGuides();
+	}
+
 	return MS::kSuccess;
 }
 
@@ -78,6 +386,113 @@ MStatus paintContextCmd::doQueryFlags()
 		setResult(fPaintContext->getMode());
 	}
 
+	if (argData.isFlagSet(kOptimizerFlag)) {
+		setResult(fPaintContext->getOptimizer());
+	}
+
+	if (argData.isFlagSet(kThreadCountFlag)) {
+		setResult(fPaintContext->getThreadCount());
+	}
+
+	if (argData.isFlagSet(kDistanceFieldFlag)) {
+		setResult(fPaintContext->getDistanceField());
+	}
+
+	if (argData.isFlagSet(kVoxelSizeFlag)) {
+		setResult(fPaintContext->getVoxelSize());
+	}
+
+	if (argData.isFlagSet(kNarrowBandFlag)) {
+		setResult(fPaintContext->getNarrowBand());
+	}
+
+	//megabytes held by the distance field, 0 when it is off or not built yet
+	if (argData.isFlagSet(kFieldMemoryFlag)) {
+		setResult(fPaintContext->getDistanceFieldMemory());
+	}
+
+	if (argData.isFlagSet(kFitToleranceFlag)) {
+		setResult(fPaintContext->getFitTolerance());
+	}
+
+	if (argData.isFlagSet(kMinSpacingFlag)) {
+		setResult(fPaintContext->getMinSpacing());
+	}
+
+	if (argData.isFlagSet(kMaxSpacingFlag)) {
+		setResult(fPaintContext->getMaxSpacing());
+	}
+
+	if (argData.isFlagSet(kSampleToleranceFlag)) {
+		setResult(fPaintContext->getSampleTolerance());
+	}
+
+	if (argData.isFlagSet(kRayBudgetFlag)) {
+		setResult(fPaintContext->getRayBudget());
+	}
+
+	if (argData.isFlagSet(kBatchConvertFlag)) {
+		setResult(fPaintContext->getBatchConvert());
+	}
+
+	//curves waiting for paint effects conversion in batch mode
+	if (argData.isFlagSet(kPendingCurvesFlag)) {
+		setResult(fPaintContext->getPendingCurves());
+	}
+
+	if (argData.isFlagSet(kTimeBudgetFlag)) {
+		setResult(fPaintContext->getTimeBudget());
+	}
+
+	if (argData.isFlagSet(kToleranceFlag)) {
+		setResult(fPaintContext->getTolerance());
+	}
+
+	if (argData.isFlagSet(kAngleWeightFlag)) {
+		setResult(fPaintContext->getAngleWeight());
+	}
+
+	if (argData.isFlagSet(kLengthWeightFlag)) {
+		setResult(fPaintContext->getLengthWeight());
+	}
+
+	if (argData.isFlagSet(kErrorWeightFlag)) {
+		setResult(fPaintContext->getErrorWeight());
+	}
+
+	if (argData.isFlagSet(kSprayFlag)) {
+		setResult(fPaintContext->getSpray());
+	}
+
+	if (argData.isFlagSet(kSprayCountFlag)) {
+		setResult(fPaintContext->getSprayCount());
+	}
+
+	if (argData.isFlagSet(kSprayRadiusFlag)) {
+		setResult(fPaintContext->getSprayRadius());
+	}
+
+	if (argData.isFlagSet(kChildCountFlag)) {
+		setResult(fPaintContext->getChildCount());
+	}
+
+	if (argData.isFlagSet(kChildRadiusFlag)) {
+		setResult(fPaintContext->getChildRadius());
+	}
+
+	//fur strokes kept as guides for interpolation
+	if (argData.isFlagSet(kGuideCountFlag)) {
+		setResult(fPaintContext->getGuideCount());
+	}
+
+	if (argData.isFlagSet(kDensityMapFlag)) {
+		setResult(fPaintContext->getDensityMap());
+	}
+
+	if (argData.isFlagSet(kScatterSpacingFlag)) {
+		setResult(fPaintContext->getScatterSpacing());
+	}
+
 	return MS::kSuccess;
 }
 
@@ -100,6 +515,149 @@ MStatus paintContextCmd::appendSyntax()
 		MGlobal::displayInfo("Mode flag init problem");
 		return MS::kFailure;
 	}
+	if (MS::kSuccess != mySyntax.addFlag(kOptimizerFlag, kOptimizerFlagLong,
+		MSyntax::kLong)) {
+		MGlobal::displayInfo("Optimizer flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kThreadCountFlag, kThreadCountFlagLong,
+		MSyntax::kLong)) {
+		MGlobal::displayInfo("Thread count flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kDistanceFieldFlag, kDistanceFieldFlagLong,
+		MSyntax::kBoolean)) {
+		MGlobal::displayInfo("Distance field flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kVoxelSizeFlag, kVoxelSizeFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Voxel size flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kNarrowBandFlag, kNarrowBandFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Narrow band flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kFieldMemoryFlag, kFieldMemoryFlagLong)) {
+		MGlobal::displayInfo("Distance field memory flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kFitToleranceFlag, kFitToleranceFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Fit tolerance flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kMinSpacingFlag, kMinSpacingFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Min spacing flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kMaxSpacingFlag, kMaxSpacingFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Max spacing flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kSampleToleranceFlag, kSampleToleranceFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Sample tolerance flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kRayBudgetFlag, kRayBudgetFlagLong,
+		MSyntax::kLong)) {
+		MGlobal::displayInfo("Ray budget flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kBatchConvertFlag, kBatchConvertFlagLong,
+		MSyntax::kBoolean)) {
+		MGlobal::displayInfo("Batch convert flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kPendingCurvesFlag, kPendingCurvesFlagLong)) {
+		MGlobal::displayInfo("Pending curves flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kFlushFlag, kFlushFlagLong)) {
+		MGlobal::displayInfo("Flush flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kTimeBudgetFlag, kTimeBudgetFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Time budget flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kToleranceFlag, kToleranceFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Tolerance flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kAngleWeightFlag, kAngleWeightFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Angle weight flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kLengthWeightFlag, kLengthWeightFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Length weight flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kErrorWeightFlag, kErrorWeightFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Error weight flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kSprayFlag, kSprayFlagLong,
+		MSyntax::kBoolean)) {
+		MGlobal::displayInfo("Spray flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kSprayCountFlag, kSprayCountFlagLong,
+		MSyntax::kLong)) {
+		MGlobal::displayInfo("Spray count flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kSprayRadiusFlag, kSprayRadiusFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Spray radius flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kChildCountFlag, kChildCountFlagLong,
+		MSyntax::kLong)) {
+		MGlobal::displayInfo("Child count flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kChildRadiusFlag, kChildRadiusFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Child radius flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kGuideCountFlag, kGuideCountFlagLong)) {
+		MGlobal::displayInfo("Guide count flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kInterpolateFurFlag, kInterpolateFurFlagLong)) {
+		MGlobal::displayInfo("Interpolate fur flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kClearGuidesFlag, kClearGuidesFlagLong)) {
+		MGlobal::displayInfo("Clear guides flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kDensityMapFlag, kDensityMapFlagLong,
+		MSyntax::kString)) {
+		MGlobal::displayInfo("Density map flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kScatterSpacingFlag, kScatterSpacingFlagLong,
+		MSyntax::kDouble)) {
+		MGlobal::displayInfo("Scatter spacing flag init problem");
+		return MS::kFailure;
+	}
+	if (MS::kSuccess != mySyntax.addFlag(kScatterFurFlag, kScatterFurFlagLong)) {
+		MGlobal::displayInfo("Scatter fur flag init problem");
+		return MS::kFailure;
+	}
 
 	return MS::kSuccess;
 }
\ No newline at end of file
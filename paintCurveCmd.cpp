@@ -0,0 +1,117 @@
+#include "paintCurveCmd.h"
+#include <maya\MFnNurbsCurve.h>
+#include <maya\MFnNurbsCurveData.h>
+#include <maya\MFnDagNode.h>
+#include <maya\MDoubleArray.h>
+#include <maya\MPlug.h>
+#include <maya\MArgList.h>
+
+paintCurveCmd::paintCurveCmd()
+{
+	fBuilt = false;
+	setCommandString("paintCurve");
+}
+
+void* paintCurveCmd::creator()
+{
+	return new paintCurveCmd;
+}
+
+void paintCurveCmd::addCurve(const MPointArray& cvs, const MDoubleArray& knots, int degree)
+{
+	Curve curve;
+	curve.cvs = cvs;
+	curve.knots = knots;
+	curve.degree = degree;
+	fCurves.push_back(curve);
+}
+
+MStatus paintCurveCmd::doIt(const MArgList&)
+{
+	return redoIt();
+}
+
+//Queues creation of a curve shape per curve and hands each its curve as cached geometry, which
+//is what the curve command does without any history
+MStatus paintCurveCmd::build()
+{
+	MStatus status;
+	if (fCurves.empty()) return MS::kFailure;
+
+	MObject group;
+	if (fGroupName.length() > 0) {
+		group = fModifier.createNode("transform", MObject::kNullObj, &status);
+		if (status != MS::kSuccess) return status;
+		status = fModifier.renameNode(group, fGroupName);
+		if (status != MS::kSuccess) return status;
+	}
+
+	MObjectArray data;
+	for (size_t i = 0; i < fCurves.size(); i++) {
+		const Curve& curve = fCurves[i];
+		if (curve.cvs.length() < 2) return MS::kFailure;
+
+		MFnNurbsCurveData dataFn;
+		MObject curveData = dataFn.create(&status);
+		if (status != MS::kSuccess) return status;
+		MFnNurbsCurve curveFn;
+		curveFn.create(curve.cvs, curve.knots, curve.degree, MFnNurbsCurve::kOpen, false, false, curveData, &status);
+		if (status != MS::kSuccess) return status;
+		data.append(curveData);
+
+		//a shape created without a parent gets a new transform, which is what comes back
+		MObject transform = fModifier.createNode("nurbsCurve", MObject::kNullObj, &status);
+		if (status != MS::kSuccess) return status;
+		if (!group.isNull()) {
+			status = fModifier.reparentNode(transform, group);
+			if (status != MS::kSuccess) return status;
+		}
+		fTransforms.append(transform);
+	}
+	status = fModifier.doIt();
+	if (status != MS::kSuccess) return status;
+
+	for (unsigned i = 0; i < fTransforms.length() && status == MS::kSuccess; i++) {
+		MFnDagNode transformFn(fTransforms[i]);
+		MObject shape = transformFn.child(0, &status);
+		if (status != MS::kSuccess) break;
+		MPlug cached = MFnDagNode(shape).findPlug("cached", true, &status);
+		if (status != MS::kSuccess) break;
+		status = fModifier.newPlugValue(cached, data[i]);
+	}
+	//the nodes are already in the scene, and an unfinished command is never finalized, so
+	//nothing could undo them later
+	if (status != MS::kSuccess) {
+		fModifier.undoIt();
+		fTransforms.clear();
+	}
+	return status;
+}
+
+MStatus paintCurveCmd::redoIt()
+{
+	if (!fBuilt) {
+		MStatus status = build();
+		if (status != MS::kSuccess) return status;
+		fBuilt = true;
+	}
+	return fModifier.doIt();
+}
+
+MStatus paintCurveCmd::undoIt()
+{
+	return fModifier.undoIt();
+}
+
+bool paintCurveCmd::isUndoable() const
+{
+	return true;
+}
+
+//records the command for undo; the points are not journaled
+MStatus paintCurveCmd::finalize()
+{
+	MArgList command;
+	command.addArg(commandString());
+	return MPxToolCommand::doFinalize(command);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <maya\MPxToolCommand.h>
+#include <maya\MDagModifier.h>
+#include <maya\MPointArray.h>
+#include <maya\MDoubleArray.h>
+#include <maya\MObject.h>
+#include <maya\MObjectArray.h>
+#include <maya\MString.h>
+#include <vector>
+
+//Tool command behind each finished stroke (or fur spray): creates the curves straight from
+//their cvs through one DAG modifier, so there is no MEL to format or parse and they undo
+//cleanly in a single step. Only created by paintContext (via newToolCommand), never typed in.
+class paintCurveCmd : public MPxToolCommand
+{
+public:
+	paintCurveCmd();
+	static void*		creator();
+
+	//knots in Maya's convention (cvs + degree - 1 of them)
+	void				addCurve(const MPointArray& cvs, const MDoubleArray& knots, int degree);
+	int					curveCount() const { return (int)fCurves.size(); }
+	//parents every curve under one new transform of this name rather than leaving each at the
+	//top of the DAG; set before redoIt
+	void				setGroup(const MString& name) { fGroupName = name; }
+	//transforms of the created curves, valid after redoIt
+	const MObjectArray&	curves() const { return fTransforms; }
+
+	virtual MStatus		doIt(const MArgList& args);
+	virtual MStatus		redoIt();
+	virtual MStatus		undoIt();
+	virtual bool		isUndoable() const;
+	virtual MStatus		finalize();
+
+private:
+	struct Curve {
+		MPointArray		cvs;
+		MDoubleArray	knots;
+		int				degree;
+	};
+
+	MStatus				build();
+
+	std::vector<Curve>	fCurves;
+	MDagModifier		fModifier;
+	MObjectArray		fTransforms;
+	MString				fGroupName;
+	bool				fBuilt;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <maya\MPoint.h>
+#include <maya\MVector.h>
+
+//The stroke's rays as structure-of-arrays: one contiguous array per coordinate so the
+//objective kernels can stream over them. Ray i is origin(i) + t[i]*direction(i).
+class RayBuffer {
+public:
+	std::vector<double> ox, oy, oz;
+	std::vector<double> dx, dy, dz;
+	std::vector<float> t;
+	//triangle closest to the ray's point at its last mesh query, -1 before the first;
+	//seeds the next query since the point rarely moves far
+	std::vector<int> tri;
+
+	int size() const { return (int)t.size(); }
+	bool empty() const { return t.empty(); }
+
+	void clear() {
+		ox.clear(); oy.clear(); oz.clear();
+		dx.clear(); dy.clear(); dz.clear();
+		t.clear(); tri.clear();
+	}
+	void reserve(int n) {
+		ox.reserve(n); oy.reserve(n); oz.reserve(n);
+		dx.reserve(n); dy.reserve(n); dz.reserve(n);
+		t.reserve(n); tri.reserve(n);
+	}
+	void push_back(const MPoint& o, const MVector& d) {
+		ox.push_back(o.x); oy.push_back(o.y); oz.push_back(o.z);
+		dx.push_back(d.x); dy.push_back(d.y); dz.push_back(d.z);
+		t.push_back(0); tri.push_back(-1);
+	}
+
+	MPoint origin(int i) const { return MPoint(ox[i], oy[i], oz[i]); }
+	MVector direction(int i) const { return MVector(dx[i], dy[i], dz[i]); }
+	MPoint point(int i) const { return MPoint(ox[i] + t[i] * dx[i], oy[i] + t[i] * dy[i], oz[i] + t[i] * dz[i]); }
+};
@@ -0,0 +1,322 @@
+#include "sceneBVH.h"
+#include <algorithm>
+#include <cmath>
+
+const int kLeafMeshes = 2;
+const int kStackSize = 128;
+//how far from orthonormal (relative to the scale) a placement may be and still be instanced
+const double kSimilarityTolerance = 1e-6;
+
+Similarity::Similarity() {
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++) linear[i][j] = i == j ? 1 : 0;
+	scale = 1;
+}
+
+bool Similarity::fromMatrix(const double m[4][4], Similarity& out) {
+	//row i of m is where object axis i ends up, so it is column i of linear
+	if (m[0][3] != 0 || m[1][3] != 0 || m[2][3] != 0 || m[3][3] != 1) return false;
+	Vec3 axis[3];
+	for (int i = 0; i < 3; i++) axis[i] = Vec3(m[i][0], m[i][1], m[i][2]);
+
+	double s2 = (length2(axis[0]) + length2(axis[1]) + length2(axis[2])) / 3;
+	if (!(s2 > 0)) return false;
+	for (int i = 0; i < 3; i++) {
+		if (std::fabs(length2(axis[i]) - s2) > kSimilarityTolerance * s2) return false;
+		if (std::fabs(dot(axis[i], axis[(i + 1) % 3])) > kSimilarityTolerance * s2) return false;
+	}
+	//mirroring flips the triangles' winding, and with it the sign of every distance
+	if (dot(cross(axis[0], axis[1]), axis[2]) <= 0) return false;
+
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++) out.linear[j][i] = axis[i][j];
+	out.translation = Vec3(m[3][0], m[3][1], m[3][2]);
+	out.scale = std::sqrt(s2);
+	return true;
+}
+
+Vec3 Similarity::toWorldVector(const Vec3& v) const {
+	return Vec3(linear[0][0] * v.x + linear[0][1] * v.y + linear[0][2] * v.z,
+		linear[1][0] * v.x + linear[1][1] * v.y + linear[1][2] * v.z,
+		linear[2][0] * v.x + linear[2][1] * v.y + linear[2][2] * v.z);
+}
+
+Vec3 Similarity::toWorld(const Vec3& p) const {
+	return toWorldVector(p) + translation;
+}
+
+//linear is scale times a rotation, so its inverse is its transpose over scale squared
+Vec3 Similarity::toObjectVector(const Vec3& v) const {
+	double s2 = scale * scale;
+	return Vec3(linear[0][0] * v.x + linear[1][0] * v.y + linear[2][0] * v.z,
+		linear[0][1] * v.x + linear[1][1] * v.y + linear[2][1] * v.z,
+		linear[0][2] * v.x + linear[1][2] * v.y + linear[2][2] * v.z) / s2;
+}
+
+Vec3 Similarity::toObject(const Vec3& p) const {
+	return toObjectVector(p - translation);
+}
+
+SceneBVH::SceneBVH() {
+	triangles = 0;
+}
+
+void SceneBVH::clear() {
+	meshes.clear(); order.clear(); nodes.clear();
+	rootBox = Box();
+	triangles = 0;
+}
+
+int SceneBVH::addMesh(const std::shared_ptr<const MeshBVH>& mesh, const Similarity& toWorld) {
+	Instance instance;
+	instance.bvh = mesh;
+	instance.toWorld = toWorld;
+	instance.firstTriangle = triangles;
+	triangles += mesh->triangleCount();
+	meshes.push_back(instance);
+	return (int)meshes.size() - 1;
+}
+
+void SceneBVH::build() {
+	nodes.clear();
+	order.clear();
+	rootBox = Box();
+	for (int i = 0; i < (int)meshes.size(); i++) {
+		Instance& instance = meshes[i];
+		instance.box = Box();
+		if (instance.bvh->empty()) continue;
+		//the world box of the eight transformed corners of the mesh's own box
+		const Box& b = instance.bvh->bounds();
+		for (int c = 0; c < 8; c++) {
+			Vec3 corner(c & 1 ? b.hi.x : b.lo.x, c & 2 ? b.hi.y : b.lo.y, c & 4 ? b.hi.z : b.lo.z);
+			instance.box.add(instance.toWorld.toWorld(corner));
+		}
+		order.push_back(i);
+	}
+	if (order.empty()) return;
+
+	nodes.reserve(2 * order.size());
+	buildRange(0, (int)order.size());
+	rootBox = nodes[0].box;
+}
+
+//there are only a handful of meshes next to the triangles below them, so a median split on
+//the widest axis is plenty
+int SceneBVH::buildRange(int begin, int end) {
+	int nodeIndex = (int)nodes.size();
+	nodes.push_back(Node());
+
+	Box box, centroidBox;
+	for (int i = begin; i < end; i++) {
+		box.add(meshes[order[i]].box);
+		centroidBox.add(meshes[order[i]].box.center());
+	}
+	nodes[nodeIndex].box = box;
+
+	int count = end - begin;
+	if (count <= kLeafMeshes) {
+		nodes[nodeIndex].index = begin;
+		nodes[nodeIndex].count = count;
+		return nodeIndex;
+	}
+
+	Vec3 ext = centroidBox.extent();
+	int axis = ext.x > ext.y ? (ext.x > ext.z ? 0 : 2) : (ext.y > ext.z ? 1 : 2);
+	int mid = begin + count / 2;
+	std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+		[this, axis](int a, int b) { return meshes[a].box.center()[axis] < meshes[b].box.center()[axis]; });
+
+	nodes[nodeIndex].count = 0;
+	buildRange(begin, mid);
+	int right = buildRange(mid, end);
+	nodes[nodeIndex].index = right;
+	return nodeIndex;
+}
+
+int SceneBVH::sceneTriangle(const SceneHit& hit) const {
+	if (hit.mesh < 0 || hit.hit.triangle < 0) return -1;
+	return meshes[hit.mesh].firstTriangle + hit.hit.triangle;
+}
+
+int SceneBVH::meshOfTriangle(int sceneTri) const {
+	int lo = 0, hi = (int)meshes.size() - 1;
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (meshes[mid].firstTriangle <= sceneTri) lo = mid;
+		else hi = mid - 1;
+	}
+	return lo;
+}
+
+void SceneBVH::triangle(int sceneTri, Vec3& a, Vec3& b, Vec3& c) const {
+	const Instance& instance = meshes[meshOfTriangle(sceneTri)];
+	const int* t = instance.bvh->triangle(sceneTri - instance.firstTriangle);
+	a = instance.toWorld.toWorld(instance.bvh->vertex(t[0]));
+	b = instance.toWorld.toWorld(instance.bvh->vertex(t[1]));
+	c = instance.toWorld.toWorld(instance.bvh->vertex(t[2]));
+}
+
+bool SceneBVH::closestOnMesh(int id, const Vec3& p, double& best2, SceneHit& hit) const {
+	const Instance& instance = meshes[id];
+	double s = instance.toWorld.scale;
+	double maxDistance = best2 < 1e300 ? std::sqrt(best2) / s : 1e300;
+
+	ClosestHit local;
+	if (!instance.bvh->closestPoint(instance.toWorld.toObject(p), local, maxDistance)) return false;
+	double d = local.distance * s;
+	if (d * d >= best2) return false;
+
+	best2 = d * d;
+	hit.hit = local;
+	hit.hit.point = instance.toWorld.toWorld(local.point);
+	hit.hit.distance = d;
+	hit.mesh = id;
+	return true;
+}
+
+bool SceneBVH::closestPoint(const Vec3& p, SceneHit& hit, double maxDistance) const {
+	if (nodes.empty()) return false;
+
+	double best2 = maxDistance < 1e150 ? maxDistance * maxDistance : 1e300;
+	bool found = false;
+
+	int stack[kStackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		if (node.box.distance2(p) >= best2) continue;
+
+		if (node.count > 0) {
+			for (int i = node.index; i < node.index + node.count; i++) {
+				if (meshes[order[i]].box.distance2(p) >= best2) continue;
+				if (closestOnMesh(order[i], p, best2, hit)) found = true;
+			}
+			continue;
+		}
+
+		//visit the nearer child first
+		int left = (int)(&node - &nodes[0]) + 1, right = node.index;
+		double dl = nodes[left].box.distance2(p), dr = nodes[right].box.distance2(p);
+		if (dl < dr) { std::swap(left, right); std::swap(dl, dr); }
+		if (dl < best2) stack[top++] = left;
+		if (dr < best2) stack[top++] = right;
+	}
+	return found;
+}
+
+//the hint's own mesh gives a tight bound quickly, then only meshes inside it are searched
+bool SceneBVH::closestPointNear(const Vec3& p, int hint, SceneHit& hit) const {
+	if (hint < 0 || hint >= triangles) return closestPoint(p, hit);
+
+	int id = meshOfTriangle(hint);
+	const Instance& instance = meshes[id];
+	ClosestHit local;
+	if (!instance.bvh->closestPointNear(instance.toWorld.toObject(p), hint - instance.firstTriangle, local))
+		return closestPoint(p, hit);
+
+	hit.hit = local;
+	hit.hit.point = instance.toWorld.toWorld(local.point);
+	hit.hit.distance = local.distance * instance.toWorld.scale;
+	hit.mesh = id;
+	SceneHit closer;
+	if (closestPoint(p, closer, hit.hit.distance * (1 - 1e-12))) hit = closer;
+	return true;
+}
+
+static Vec3 inverseDirection(const Vec3& d) {
+	return Vec3(d.x != 0 ? 1 / d.x : 1e300, d.y != 0 ? 1 / d.y : 1e300, d.z != 0 ? 1 / d.z : 1e300);
+}
+
+//an affine map keeps the ray's parameter, so t found in a mesh's space is t in the world
+bool SceneBVH::raycast(const Vec3& origin, const Vec3& direction, SceneRayHit& hit, double tMax) const {
+	if (nodes.empty()) return false;
+
+	Vec3 invDir = inverseDirection(direction);
+	double best = tMax;
+	bool found = false;
+
+	int stack[kStackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		double tNear = 0, tFar = best;
+		if (!node.box.intersect(origin, invDir, tNear, tFar)) continue;
+
+		if (node.count > 0) {
+			for (int i = node.index; i < node.index + node.count; i++) {
+				const Instance& instance = meshes[order[i]];
+				double mn = 0, mf = best;
+				if (!instance.box.intersect(origin, invDir, mn, mf)) continue;
+				RayHit local;
+				if (instance.bvh->raycast(instance.toWorld.toObject(origin),
+					instance.toWorld.toObjectVector(direction), local, best)) {
+					best = local.t; found = true;
+					hit.hit = local; hit.mesh = order[i];
+				}
+			}
+			continue;
+		}
+
+		int left = (int)(&node - &nodes[0]) + 1, right = node.index;
+		double ln = 0, lf = best, rn = 0, rf = best;
+		bool hl = nodes[left].box.intersect(origin, invDir, ln, lf);
+		bool hr = nodes[right].box.intersect(origin, invDir, rn, rf);
+		if (hl && hr) {
+			//push the farther child first so the nearer one is popped next
+			if (ln < rn) { stack[top++] = right; stack[top++] = left; }
+			else { stack[top++] = left; stack[top++] = right; }
+		}
+		else if (hl) stack[top++] = left;
+		else if (hr) stack[top++] = right;
+	}
+	return found;
+}
+
+bool SceneBVH::intersects(const Vec3& origin, const Vec3& direction) const {
+	if (nodes.empty()) return false;
+
+	Vec3 invDir = inverseDirection(direction);
+	int stack[kStackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		double tNear = 0, tFar = 1e300;
+		if (!node.box.intersect(origin, invDir, tNear, tFar)) continue;
+
+		if (node.count > 0) {
+			for (int i = node.index; i < node.index + node.count; i++) {
+				const Instance& instance = meshes[order[i]];
+				if (instance.bvh->intersects(instance.toWorld.toObject(origin),
+					instance.toWorld.toObjectVector(direction)))
+					return true;
+			}
+			continue;
+		}
+		stack[top++] = (int)(&node - &nodes[0]) + 1;
+		stack[top++] = node.index;
+	}
+	return false;
+}
+
+Vec3 SceneBVH::pseudoNormal(const SceneHit& hit) const {
+	if (hit.mesh < 0) return Vec3();
+	const Instance& instance = meshes[hit.mesh];
+	return instance.toWorld.toWorldVector(instance.bvh->pseudoNormal(hit.hit)) / instance.toWorld.scale;
+}
+
+//inside is decided by the nearest mesh alone, so overlapping meshes each keep their own inside
+double SceneBVH::signedDistance(const Vec3& p, SceneHit* hitOut) const {
+	SceneHit hit;
+	if (!closestPoint(p, hit)) return 1e300;
+	if (hitOut) *hitOut = hit;
+	return dot(p - hit.hit.point, pseudoNormal(hit)) < 0 ? -hit.hit.distance : hit.hit.distance;
+}
+
+size_t SceneBVH::memoryBytes() const {
+	return nodes.capacity() * sizeof(Node)
+		+ order.capacity() * sizeof(int)
+		+ meshes.capacity() * sizeof(Instance);
+}
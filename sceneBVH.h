@@ -0,0 +1,106 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include "vec3.h"
+#include "meshBVH.h"
+
+//Placement of a mesh in the world: p_world = linear * p_object + translation, where linear is
+//a rotation times a positive uniform scale. Only such transforms keep the closest point
+//closest, so anything else (shear, non-uniform scale, mirroring) is baked into the mesh's
+//vertices and placed with the identity.
+struct Similarity {
+	double linear[3][3];
+	Vec3 translation;
+	double scale;
+
+	Similarity();
+
+	//m is an affine matrix in Maya's row vector layout (translation in the last row).
+	//False, leaving out untouched, if it isn't a similarity.
+	static bool fromMatrix(const double m[4][4], Similarity& out);
+
+	Vec3 toWorld(const Vec3& p) const;
+	Vec3 toWorldVector(const Vec3& v) const;
+	Vec3 toObject(const Vec3& p) const;
+	Vec3 toObjectVector(const Vec3& v) const;
+};
+
+//Closest point on the scene: hit.point and hit.distance are in world space, while triangle,
+//u, v and feature refer to the mesh, which is the id returned by addMesh (-1 if none)
+struct SceneHit {
+	ClosestHit hit;
+	int mesh;
+
+	SceneHit() : mesh(-1) {}
+};
+
+//Ray against the scene: t is along the world space ray
+struct SceneRayHit {
+	RayHit hit;
+	int mesh;
+
+	SceneRayHit() : mesh(-1) {}
+};
+
+//Top level hierarchy over any number of mesh BVHs, each with its own world placement. A mesh
+//BVH is shared, not copied, so meshes that haven't changed are reused from scene to scene and
+//instances of one shape share a single tree. Maya-free; once built every query is const and
+//may be issued from any number of threads.
+class SceneBVH {
+public:
+	SceneBVH();
+
+	//returns the mesh id used in hits; call build() once everything has been added
+	int addMesh(const std::shared_ptr<const MeshBVH>& mesh, const Similarity& toWorld);
+	void build();
+	void clear();
+	bool empty() const { return nodes.empty(); }
+
+	//the same queries as MeshBVH, in world space, over every mesh
+	bool closestPoint(const Vec3& p, SceneHit& hit, double maxDistance = 1e300) const;
+	//hint is a scene triangle (see sceneTriangle) found by a nearby query, or -1
+	bool closestPointNear(const Vec3& p, int hint, SceneHit& hit) const;
+	bool raycast(const Vec3& origin, const Vec3& direction, SceneRayHit& hit, double tMax = 1e300) const;
+	bool intersects(const Vec3& origin, const Vec3& direction) const;
+	double signedDistance(const Vec3& p, SceneHit* hit = 0) const;
+	Vec3 pseudoNormal(const SceneHit& hit) const;
+
+	//triangles are numbered across the scene, mesh after mesh, so a single int can seed a query
+	int sceneTriangle(const SceneHit& hit) const;
+	int triangleCount() const { return triangles; }
+	//world space corners of a scene triangle
+	void triangle(int sceneTri, Vec3& a, Vec3& b, Vec3& c) const;
+
+	int meshCount() const { return (int)meshes.size(); }
+	const MeshBVH& mesh(int id) const { return *meshes[id].bvh; }
+	const Similarity& placement(int id) const { return meshes[id].toWorld; }
+	const Box& bounds() const { return rootBox; }
+	//the top level only; mesh BVHs are shared and report their own
+	size_t memoryBytes() const;
+
+private:
+	struct Instance {
+		std::shared_ptr<const MeshBVH> bvh;
+		Similarity toWorld;
+		Box box; //world space
+		int firstTriangle;
+	};
+	//same layout as MeshBVH: leaves store a range of order, the left child follows its parent
+	struct Node {
+		Box box;
+		int index;
+		int count;
+	};
+
+	int buildRange(int begin, int end);
+	int meshOfTriangle(int sceneTri) const;
+	//closest point on one mesh if nearer than best2 (squared, world space)
+	bool closestOnMesh(int id, const Vec3& p, double& best2, SceneHit& hit) const;
+
+	std::vector<Instance> meshes;
+	std::vector<int> order;
+	std::vector<Node> nodes;
+	Box rootBox;
+	int triangles;
+};
@@ -0,0 +1,111 @@
+#include "solveQueue.h"
+#include <maya\MEventMessage.h>
+
+SolveQueue::SolveQueue(const std::function<void(std::vector<StrokeSolver>&)>& commit) : commitFn(commit),
+	pool(0), quitting(false), idleCallback(0), idleRegistered(false), strokeInProgress(false)
+{
+	worker = std::thread(&SolveQueue::workerLoop, this);
+}
+
+SolveQueue::~SolveQueue() {
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		quitting = true;
+	}
+	wake.notify_all();
+	worker.join();
+	if (idleRegistered) MMessage::removeCallback(idleCallback);
+}
+
+void SolveQueue::submit(StrokeSolver&& stroke) {
+	std::vector<StrokeSolver> batch;
+	batch.push_back(std::move(stroke));
+	submit(std::move(batch));
+}
+
+void SolveQueue::submit(std::vector<StrokeSolver>&& batch) {
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		jobs.push_back(std::unique_ptr<Job>(new Job(std::move(batch))));
+		waiting.push_back(jobs.back().get());
+	}
+	wake.notify_all();
+
+	if (!idleRegistered) {
+		MStatus s;
+		idleCallback = MEventMessage::addEventCallback("idle", onIdle, this, &s);
+		idleRegistered = s == MS::kSuccess;
+	}
+}
+
+void SolveQueue::workerLoop() {
+	while (true) {
+		Job* job;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [&]() { return quitting || !waiting.empty(); });
+			if (quitting) return;
+			job = waiting.front();
+			waiting.pop_front();
+		}
+		//the main thread never touches a job before it is marked solved
+		std::vector<StrokeSolver>& strokes = job->strokes;
+		//the time budget covers the whole job, so a spray's strands share one deadline
+		std::chrono::steady_clock::time_point deadline;
+		if (!strokes.empty()) deadline = strokes[0].deadlineFromNow();
+		if (strokes.size() > 1 && pool) {
+			pool->parallelFor((int)strokes.size(), [&strokes, deadline](int i) { strokes[i].solve(deadline); });
+		} else {
+			for (size_t i = 0; i < strokes.size(); i++) strokes[i].solve(deadline);
+		}
+		StrokeSolver::resolvePenetration(strokes, pool);
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			job->solved = true;
+		}
+		solvedOne.notify_all();
+	}
+}
+
+//Maya may go idle between the drag events of the next stroke; its commit waits for the release
+void SolveQueue::commitFinished() {
+	if (strokeInProgress) return;
+	commitSolved();
+}
+
+void SolveQueue::commitSolved() {
+	while (true) {
+		std::unique_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			if (jobs.empty() || !jobs.front()->solved) break;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		commitFn(job->strokes);
+	}
+
+	//idle callbacks keep Maya spinning, so drop it once nothing is left
+	if (idleRegistered && pending() == 0) {
+		MMessage::removeCallback(idleCallback);
+		idleRegistered = false;
+	}
+}
+
+void SolveQueue::finish() {
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		solvedOne.wait(guard, [&]() { return jobs.empty() || jobs.back()->solved; });
+	}
+	//called when the tool goes away or the artist asks for everything, so even mid-stroke
+	commitSolved();
+}
+
+int SolveQueue::pending() const {
+	std::unique_lock<std::mutex> guard(lock);
+	return (int)jobs.size();
+}
+
+void SolveQueue::onIdle(void* clientData) {
+	static_cast<SolveQueue*>(clientData)->commitFinished();
+}
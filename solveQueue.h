@@ -0,0 +1,64 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <maya\MMessage.h>
+#include "strokeSolver.h"
+
+//Solves finished strokes on a background thread, one at a time in the order they were
+//submitted, and hands each one back on Maya's main thread from an idle callback, in that same
+//order. A batch of strokes (a fur spray) is solved across the thread pool and handed back
+//together. Strand points left inside a mesh are pushed out before a job is handed back.
+//The idle callback is only registered while something is outstanding.
+class SolveQueue {
+public:
+	//commit is called on the main thread with each solved stroke or batch
+	explicit SolveQueue(const std::function<void(std::vector<StrokeSolver>&)>& commit);
+	//waits for the stroke being solved; strokes not yet committed are dropped
+	~SolveQueue();
+
+	//workers for solving batches; without them a batch is solved one stroke after another
+	void setThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+
+	//takes the stroke or batch over; main thread only
+	void submit(StrokeSolver&& stroke);
+	void submit(std::vector<StrokeSolver>&& batch);
+	//commits every solved stroke at the front of the queue; main thread only. Does nothing
+	//while a stroke is being drawn, so no tool command or conversion lands mid-gesture
+	void commitFinished();
+	//set from press to release; main thread only
+	void setStrokeInProgress(bool drawing) { strokeInProgress = drawing; }
+	//blocks until everything submitted is solved and committed; main thread only
+	void finish();
+	int pending() const;
+
+private:
+	void commitSolved();
+
+	struct Job {
+		std::vector<StrokeSolver> strokes;
+		bool solved;
+		explicit Job(std::vector<StrokeSolver>&& s) : strokes(std::move(s)), solved(false) {}
+	};
+
+	static void onIdle(void* clientData);
+	void workerLoop();
+
+	std::function<void(std::vector<StrokeSolver>&)> commitFn;
+	ThreadPool* pool;
+	//every uncommitted job, oldest first; jobs are only destroyed on the main thread
+	std::deque<std::unique_ptr<Job> > jobs;
+	//jobs the worker has yet to start, in the same order
+	std::deque<Job*> waiting;
+
+	mutable std::mutex lock;
+	std::condition_variable wake, solvedOne;
+	bool quitting;
+	std::thread worker;
+	MCallbackId idleCallback;
+	bool idleRegistered;
+	bool strokeInProgress;
+};
@@ -0,0 +1,121 @@
+#include "sparseSDF.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cmath>
+
+const int kSamplesPerBrick = SparseSDF::kBrickSamples * SparseSDF::kBrickSamples * SparseSDF::kBrickSamples;
+
+SparseSDF::SparseSDF() {
+	voxel = 0;
+	band = 0;
+}
+
+void SparseSDF::clear() {
+	bricks.clear();
+	brickOrigins.clear();
+	samples.clear();
+}
+
+//21 bits per axis, biased so negative brick coordinates pack too
+long long SparseSDF::brickKey(int i, int j, int k) {
+	const long long bias = 1 << 20;
+	return ((i + bias) << 42) | ((j + bias) << 21) | (k + bias);
+}
+
+void SparseSDF::build(const SceneBVH& scene, double voxelSize, double bandWidth, ThreadPool& pool) {
+	clear();
+	voxel = voxelSize;
+	band = bandWidth;
+	if (scene.empty() || voxel <= 0) return;
+
+	//collect every brick touched by a triangle's box grown by the band
+	double brickSize = voxel * kBrickCells;
+	std::vector<long long> keys;
+	for (int t = 0; t < scene.triangleCount(); t++) {
+		Vec3 v0, v1, v2;
+		scene.triangle(t, v0, v1, v2);
+		Box b;
+		b.add(v0); b.add(v1); b.add(v2);
+		int lo[3], hi[3];
+		for (int a = 0; a < 3; a++) {
+			lo[a] = (int)std::floor((b.lo[a] - band) / brickSize);
+			hi[a] = (int)std::floor((b.hi[a] + band) / brickSize);
+		}
+		for (int i = lo[0]; i <= hi[0]; i++)
+			for (int j = lo[1]; j <= hi[1]; j++)
+				for (int k = lo[2]; k <= hi[2]; k++)
+					keys.push_back(brickKey(i, j, k));
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+	int count = (int)keys.size();
+	const long long mask = (1 << 21) - 1, bias = 1 << 20;
+	brickOrigins.resize(3 * count);
+	bricks.reserve(count);
+	for (int b = 0; b < count; b++) {
+		brickOrigins[3 * b] = (int)(((keys[b] >> 42) & mask) - bias) * kBrickCells;
+		brickOrigins[3 * b + 1] = (int)(((keys[b] >> 21) & mask) - bias) * kBrickCells;
+		brickOrigins[3 * b + 2] = (int)((keys[b] & mask) - bias) * kBrickCells;
+		bricks[keys[b]] = b;
+	}
+	samples.resize((size_t)count * kSamplesPerBrick);
+
+	//bricks are independent, so they are filled in parallel
+	pool.parallelFor(count, [this, &scene](int b) {
+		float* out = &samples[(size_t)b * kSamplesPerBrick];
+		const int* o = &brickOrigins[3 * b];
+		for (int k = 0; k < kBrickSamples; k++)
+			for (int j = 0; j < kBrickSamples; j++)
+				for (int i = 0; i < kBrickSamples; i++) {
+					Vec3 p((o[0] + i) * voxel, (o[1] + j) * voxel, (o[2] + k) * voxel);
+					*out++ = (float)scene.signedDistance(p);
+				}
+	});
+}
+
+bool SparseSDF::sample(const Vec3& p, double& distance, Vec3* gradient) const {
+	if (bricks.empty()) return false;
+
+	double gx = p.x / voxel, gy = p.y / voxel, gz = p.z / voxel;
+	int cx = (int)std::floor(gx), cy = (int)std::floor(gy), cz = (int)std::floor(gz);
+	int bx = (int)std::floor((double)cx / kBrickCells);
+	int by = (int)std::floor((double)cy / kBrickCells);
+	int bz = (int)std::floor((double)cz / kBrickCells);
+
+	std::unordered_map<long long, int>::const_iterator it = bricks.find(brickKey(bx, by, bz));
+	if (it == bricks.end()) return false;
+
+	//local cell and its fractional position
+	int i = cx - bx * kBrickCells, j = cy - by * kBrickCells, k = cz - bz * kBrickCells;
+	double fx = gx - cx, fy = gy - cy, fz = gz - cz;
+
+	const float* s = &samples[(size_t)it->second * kSamplesPerBrick];
+	const int sy = kBrickSamples, sz = kBrickSamples * kBrickSamples;
+	const float* c = s + i + j * sy + k * sz;
+	double c000 = c[0], c100 = c[1], c010 = c[sy], c110 = c[sy + 1];
+	double c001 = c[sz], c101 = c[sz + 1], c011 = c[sz + sy], c111 = c[sz + sy + 1];
+
+	double c00 = c000 + (c100 - c000) * fx, c10 = c010 + (c110 - c010) * fx;
+	double c01 = c001 + (c101 - c001) * fx, c11 = c011 + (c111 - c011) * fx;
+	double c0 = c00 + (c10 - c00) * fy, c1 = c01 + (c11 - c01) * fy;
+	distance = c0 + (c1 - c0) * fz;
+
+	if (gradient) {
+		//derivative of the trilinear interpolant, scaled back to world units
+		double dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * fy;
+		double dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * fy;
+		gradient->x = (dx0 + (dx1 - dx0) * fz) / voxel;
+		gradient->y = ((c10 - c00) + ((c11 - c01) - (c10 - c00)) * fz) / voxel;
+		gradient->z = (c1 - c0) / voxel;
+	}
+	return true;
+}
+
+size_t SparseSDF::memoryBytes() const {
+	//each hash entry is roughly a node with key, value and a bucket pointer
+	return samples.capacity() * sizeof(float)
+		+ brickOrigins.capacity() * sizeof(int)
+		+ bricks.size() * (sizeof(long long) + sizeof(int) + 2 * sizeof(void*))
+		+ bricks.bucket_count() * sizeof(void*);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include "vec3.h"
+#include "sceneBVH.h"
+
+class ThreadPool;
+
+//Sparse signed distance field sampled on a regular lattice, stored only in bricks that lie
+//within a narrow band of the surface. Lookups are a hash probe plus trilinear interpolation.
+class SparseSDF {
+public:
+	SparseSDF();
+
+	//sample the scene's signed distance everywhere within band of its triangles, spread over pool
+	void build(const SceneBVH& scene, double voxelSize, double band, ThreadPool& pool);
+	void clear();
+	bool empty() const { return bricks.empty(); }
+
+	//false if p is outside the band, in which case distance and gradient are untouched
+	bool sample(const Vec3& p, double& distance, Vec3* gradient = 0) const;
+
+	double voxelSize() const { return voxel; }
+	double bandWidth() const { return band; }
+	size_t brickCount() const { return brickOrigins.size(); }
+	size_t memoryBytes() const;
+
+	//cells per brick edge; bricks store one extra layer of samples so every cell is self contained
+	static const int kBrickCells = 8;
+	static const int kBrickSamples = kBrickCells + 1;
+
+private:
+	static long long brickKey(int i, int j, int k);
+
+	double voxel;
+	double band;
+	std::unordered_map<long long, int> bricks;
+	std::vector<int> brickOrigins; //3 lattice coordinates per brick
+	std::vector<float> samples; //kBrickSamples^3 per brick, x fastest
+};
@@ -0,0 +1,78 @@
+#include "strokeInput.h"
+#include <maya\MMatrix.h>
+#include <cmath>
+
+StrokeInput::StrokeInput()
+{
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++) inverse[r][c] = r == c ? 1 : 0;
+	portX = portY = 0;
+	portWidth = portHeight = 1;
+	head = 0;
+	count = 0;
+}
+
+void StrokeInput::begin(M3dView& view) {
+	MMatrix modelView, projection;
+	view.modelViewMatrix(modelView);
+	view.projectionMatrix(projection);
+	(modelView * projection).inverse().get(inverse);
+
+	unsigned x, y, width, height;
+	view.viewport(x, y, width, height);
+	portX = x; portY = y;
+	portWidth = width > 0 ? width : 1;
+	portHeight = height > 0 ? height : 1;
+
+	head = 0;
+	count = 0;
+}
+
+bool StrokeInput::push(short x, short y, double time) {
+	if (count == kCapacity) return false;
+	InputEvent& e = ring[(head + count) % kCapacity];
+	e.x = x; e.y = y; e.time = time;
+	count++;
+	return true;
+}
+
+void StrokeInput::drain(std::vector<InputEvent>& out) {
+	for (int i = 0; i < count; i++) out.push_back(ring[(head + i) % kCapacity]);
+	head = (head + count) % kCapacity;
+	count = 0;
+}
+
+//Pixel -> normalized device coordinates -> world on the near (z = -1) and far (z = 1) planes.
+//Branch free over the arrays so the compiler vectorizes it.
+void StrokeInput::unproject(int n, const double* x, const double* y,
+	double* ox, double* oy, double* oz, double* dx, double* dy, double* dz) const {
+	const double (*m)[4] = inverse;
+	double sx = 2 / portWidth, sy = 2 / portHeight;
+	for (int i = 0; i < n; i++) {
+		double nx = (x[i] - portX) * sx - 1;
+		double ny = (y[i] - portY) * sy - 1;
+
+		//shared part of both planes, then the z row added or subtracted
+		double bx = nx * m[0][0] + ny * m[1][0] + m[3][0];
+		double by = nx * m[0][1] + ny * m[1][1] + m[3][1];
+		double bz = nx * m[0][2] + ny * m[1][2] + m[3][2];
+		double bw = nx * m[0][3] + ny * m[1][3] + m[3][3];
+
+		double nearW = 1 / (bw - m[2][3]);
+		double farW = 1 / (bw + m[2][3]);
+		double px = (bx - m[2][0]) * nearW, py = (by - m[2][1]) * nearW, pz = (bz - m[2][2]) * nearW;
+		double vx = (bx + m[2][0]) * farW - px;
+		double vy = (by + m[2][1]) * farW - py;
+		double vz = (bz + m[2][2]) * farW - pz;
+		double len = std::sqrt(vx * vx + vy * vy + vz * vz);
+		double inv = len > 0 ? 1 / len : 0;
+
+		ox[i] = px; oy[i] = py; oz[i] = pz;
+		dx[i] = vx * inv; dy[i] = vy * inv; dz[i] = vz * inv;
+	}
+}
+
+void StrokeInput::unproject(short x, short y, MPoint& origin, MVector& direction) const {
+	double px = x, py = y;
+	unproject(1, &px, &py, &origin.x, &origin.y, &origin.z, &direction.x, &direction.y, &direction.z);
+}
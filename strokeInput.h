@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <maya\M3dView.h>
+#include <maya\MPoint.h>
+#include <maya\MVector.h>
+
+//A pen position as it arrived, time in seconds
+struct InputEvent {
+	short x, y;
+	double time;
+};
+
+//Drag positions waiting to be turned into rays, and the view they are unprojected through.
+//This only batches: doDrag queues positions in a fixed ring on the main thread, and the same
+//thread turns them into rays about once a frame. The view's inverse view-projection is
+//cached at press, so a batch unprojects with plain loops over arrays instead of one
+//M3dView::viewToWorld call per position.
+class StrokeInput {
+public:
+	StrokeInput();
+
+	//caches view's matrices and empties the ring; main thread, at press
+	void begin(M3dView& view);
+
+	//false when the ring is full and has to be drained before this position fits
+	bool push(short x, short y, double time);
+	int pending() const { return count; }
+	//appends everything queued to out, oldest first, and empties the ring
+	void drain(std::vector<InputEvent>& out);
+
+	//world space rays through n pixels, as viewToWorld gives them: the origin on the near
+	//plane and a unit direction
+	void unproject(int n, const double* x, const double* y,
+		double* ox, double* oy, double* oz, double* dx, double* dy, double* dz) const;
+	void unproject(short x, short y, MPoint& origin, MVector& direction) const;
+
+	static const int kCapacity = 1024;
+
+private:
+	double inverse[4][4]; //inverse of model view * projection, row vector convention
+	double portX, portY, portWidth, portHeight;
+
+	InputEvent ring[kCapacity];
+	int head, count;
+};
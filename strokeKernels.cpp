@@ -0,0 +1,77 @@
+#include "strokeKernels.h"
+#include <cmath>
+
+#if defined(_MSC_VER)
+#define RESTRICT __restrict
+#else
+#define RESTRICT __restrict__
+#endif
+
+void StrokeTerms::resize(int n) {
+	px.resize(n); py.resize(n); pz.resize(n);
+	int segments = n > 1 ? n - 1 : 0;
+	ux.resize(segments); uy.resize(segments); uz.resize(segments); len.resize(segments);
+	angle.resize(n); length.resize(n);
+}
+
+void computePoints(int n, const double* RESTRICT ox, const double* RESTRICT oy, const double* RESTRICT oz,
+	const double* RESTRICT dx, const double* RESTRICT dy, const double* RESTRICT dz, const float* RESTRICT t,
+	double* RESTRICT px, double* RESTRICT py, double* RESTRICT pz) {
+	for (int i = 0; i < n; i++) {
+		double ti = t[i];
+		px[i] = ox[i] + ti * dx[i];
+		py[i] = oy[i] + ti * dy[i];
+		pz[i] = oz[i] + ti * dz[i];
+	}
+}
+
+//unit vector and length of every segment
+static void computeSegments(int segments, const double* RESTRICT px, const double* RESTRICT py, const double* RESTRICT pz,
+	double* RESTRICT ux, double* RESTRICT uy, double* RESTRICT uz, double* RESTRICT len) {
+	for (int s = 0; s < segments; s++) {
+		double x = px[s + 1] - px[s], y = py[s + 1] - py[s], z = pz[s + 1] - pz[s];
+		double l = std::sqrt(x * x + y * y + z * z);
+		//zero length segments get a zero direction, matching MVector::normal()
+		double inv = l > 0 ? 1 / l : 0;
+		ux[s] = x * inv; uy[s] = y * inv; uz[s] = z * inv;
+		len[s] = l;
+	}
+}
+
+//(1 - u[i-2] . u[i-1])^2, the cost of the bend at ray i-1, stored at i
+static void computeAngles(int n, const double* RESTRICT ux, const double* RESTRICT uy, const double* RESTRICT uz,
+	double* RESTRICT angle) {
+	if (n > 0) angle[0] = 0;
+	if (n > 1) angle[1] = 0;
+	for (int i = 2; i < n; i++) {
+		double c = 1 - (ux[i - 2] * ux[i - 1] + uy[i - 2] * uy[i - 1] + uz[i - 2] * uz[i - 1]);
+		angle[i] = c * c;
+	}
+}
+
+//squared length of the segments on either side of each ray
+static void computeLengths(int n, const double* RESTRICT len, double* RESTRICT length) {
+	if (n == 1) length[0] = 0;
+	if (n < 2) return;
+	length[0] = len[0] * len[0];
+	length[n - 1] = len[n - 2] * len[n - 2];
+	for (int i = 1; i < n - 1; i++) length[i] = len[i - 1] * len[i - 1] + len[i] * len[i];
+}
+
+void evaluateStrokeTerms(int n, const double* ox, const double* oy, const double* oz,
+	const double* dx, const double* dy, const double* dz, const float* t, StrokeTerms& terms) {
+	terms.resize(n);
+	if (n == 0) return;
+	computePoints(n, ox, oy, oz, dx, dy, dz, t, &terms.px[0], &terms.py[0], &terms.pz[0]);
+	if (n > 1) computeSegments(n - 1, &terms.px[0], &terms.py[0], &terms.pz[0],
+		&terms.ux[0], &terms.uy[0], &terms.uz[0], &terms.len[0]);
+	computeAngles(n, n > 1 ? &terms.ux[0] : 0, n > 1 ? &terms.uy[0] : 0, n > 1 ? &terms.uz[0] : 0, &terms.angle[0]);
+	computeLengths(n, n > 1 ? &terms.len[0] : 0, &terms.length[0]);
+}
+
+double weightedSum(int n, const double* RESTRICT values, const double* RESTRICT w) {
+	double sum = 0;
+	if (w) for (int i = 0; i < n; i++) sum += values[i] * w[i];
+	else for (int i = 0; i < n; i++) sum += values[i];
+	return sum;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+
+//Whole-stroke evaluation of the geometric objective terms over structure-of-arrays rays.
+//The loops are branch free over contiguous arrays so the compiler vectorizes them
+//(SSE2/AVX on x64 release builds); nothing here touches Maya.
+struct StrokeTerms {
+	//point of every ray
+	std::vector<double> px, py, pz;
+	//unit segment i -> i+1 and its length, n-1 entries
+	std::vector<double> ux, uy, uz, len;
+	//angleTerm and lengthTerm of every ray (angle is 0 for rays 0 and 1)
+	std::vector<double> angle, length;
+
+	void resize(int n);
+};
+
+//p = o + t*d for every ray
+void computePoints(int n, const double* ox, const double* oy, const double* oz,
+	const double* dx, const double* dy, const double* dz, const float* t,
+	double* px, double* py, double* pz);
+
+//fills every array of terms from the ray arrays
+void evaluateStrokeTerms(int n, const double* ox, const double* oy, const double* oz,
+	const double* dx, const double* dy, const double* dz, const float* t, StrokeTerms& terms);
+
+//sum of w[i]*values[i], w may be null for all ones
+double weightedSum(int n, const double* values, const double* w);
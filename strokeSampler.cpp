@@ -0,0 +1,86 @@
+#include "strokeSampler.h"
+#include <algorithm>
+#include <cmath>
+
+//pen speed (pixels per second) at which the tolerance has doubled
+const double kReferenceSpeed = 2000;
+
+StrokeSampler::StrokeSampler()
+{
+	minGap = 2;
+	maxGap = 40;
+	tol = 0.5;
+	rayBudget = 0;
+	last.x = last.y = 0;
+	lastTime = 0;
+	kept = 0;
+}
+
+void StrokeSampler::setSpacing(double minSpacing, double maxSpacing) {
+	minGap = std::max(0.0, minSpacing);
+	maxGap = std::max(minGap, maxSpacing);
+}
+
+void StrokeSampler::setTolerance(double pixels) {
+	tol = std::max(0.0, pixels);
+}
+
+void StrokeSampler::setBudget(int rays) {
+	rayBudget = std::max(0, rays);
+}
+
+void StrokeSampler::begin(double x, double y, double time) {
+	last.x = x; last.y = y;
+	lastTime = time;
+	kept = 1;
+	between.clear();
+}
+
+bool StrokeSampler::accept(double x, double y, double time) {
+	double cx = x - last.x, cy = y - last.y;
+	double chord = std::sqrt(cx * cx + cy * cy);
+
+	//spacing and tolerance stretch as the budget runs out: with r of b rays left they are b / r
+	//times as wide. One ray is kept back for the release, which ends the stroke
+	int drawn = rayBudget - 1;
+	if (rayBudget > 0 && kept >= drawn) return false;
+	double scale = rayBudget > 0 ? (double)drawn / (drawn - kept) : 1;
+	if (chord < minGap * scale) {
+		between.push_back(Sample{ x, y });
+		return false;
+	}
+
+	double elapsed = time - lastTime;
+	double speed = elapsed > 0 ? chord / elapsed : 0;
+	double allowed = tol * scale * (1 + speed / kReferenceSpeed);
+
+	//largest distance of the skipped positions from the chord, as a segment: a stroke doubling
+	//back along itself stays on the chord's line but runs past its ends
+	double deviation = 0;
+	for (size_t i = 0; i < between.size(); i++) {
+		double px = between[i].x - last.x, py = between[i].y - last.y;
+		double along = std::min(std::max((px * cx + py * cy) / (chord * chord), 0.0), 1.0);
+		deviation = std::max(deviation, std::hypot(px - along * cx, py - along * cy));
+	}
+
+	if (deviation <= allowed && chord < maxGap * scale) {
+		between.push_back(Sample{ x, y });
+		return false;
+	}
+
+	last.x = x; last.y = y;
+	lastTime = time;
+	kept++;
+	between.clear();
+	return true;
+}
+
+bool StrokeSampler::end(double x, double y) {
+	if (rayBudget > 0 && kept >= rayBudget) return false;
+	double chord = std::hypot(x - last.x, y - last.y);
+	if (chord == 0 || chord < minGap) return false;
+	last.x = x; last.y = y;
+	kept++;
+	between.clear();
+	return true;
+}
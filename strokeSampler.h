@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+
+//Decides which mouse positions of a stroke become rays, in screen space. A position is kept
+//once the path since the last kept one strays from the straight chord between them by more
+//than the tolerance (so curls are sampled densely and straight runs sparsely), or once the
+//chord reaches the maximum spacing. Nothing closer than the minimum spacing is kept.
+//Fast strokes are imprecise anyway, so the tolerance grows with pen speed. With a ray budget
+//the tolerance and the spacing widen as it is used up, so a stroke keeps to about that many;
+//the last of it is held back for the release.
+class StrokeSampler {
+public:
+	StrokeSampler();
+
+	//in pixels
+	void setSpacing(double minSpacing, double maxSpacing);
+	void setTolerance(double pixels);
+	//most rays kept per stroke, sampling coarser as they are used up; 0 for no budget
+	void setBudget(int rays);
+
+	double minSpacing() const { return minGap; }
+	double maxSpacing() const { return maxGap; }
+	double tolerance() const { return tol; }
+	int budget() const { return rayBudget; }
+
+	//the press position, always kept; time in seconds
+	void begin(double x, double y, double time);
+	//true when this position should become a ray
+	bool accept(double x, double y, double time);
+	//the release position: true when it should end the stroke as one more ray, false when it
+	//is within the minimum spacing of the last kept position or the budget is spent
+	bool end(double x, double y);
+
+private:
+	struct Sample { double x, y; };
+
+	double minGap, maxGap, tol;
+	int rayBudget;
+
+	Sample last; //last kept position
+	double lastTime;
+	int kept;
+	std::vector<Sample> between; //positions seen since the last kept one
+};
@@ -0,0 +1,301 @@
+#include "strokeSession.h"
+#include <maya\MItDag.h>
+#include <maya\MFnMesh.h>
+#include <maya\MPointArray.h>
+#include <maya\MIntArray.h>
+#include <maya\MGlobal.h>
+#include <maya\MFnDagNode.h>
+#include <maya\MMatrix.h>
+#include <maya\MObjectHandle.h>
+#include <maya\MNodeMessage.h>
+#include <atomic>
+#include <cstring>
+#include <cmath>
+
+StrokeSession::StrokeSession()
+{
+	valid = false;
+	pool = 0;
+	sdfEnabled = false;
+	sdfVoxelSize = 0;
+	sdfBand = 0;
+	sdfMinBand = 0;
+}
+
+void StrokeSession::setDistanceField(bool enabled, double voxelSize, double band, double minBand) {
+	sdfEnabled = enabled;
+	sdfVoxelSize = voxelSize;
+	sdfBand = band;
+	sdfMinBand = minBand;
+	if (!sdfEnabled) sdf.reset();
+}
+
+//FNV-1a over the world space points, cheap next to a rebuild and catches any vertex edit
+static unsigned long long hashPoints(const MPointArray& points) {
+	unsigned long long h = 1469598103934665603ULL;
+	for (unsigned i = 0; i < points.length(); i++) {
+		double xyz[3] = { points[i].x, points[i].y, points[i].z };
+		unsigned char bytes[sizeof(xyz)];
+		memcpy(bytes, xyz, sizeof(xyz));
+		for (unsigned b = 0; b < sizeof(bytes); b++) {
+			h ^= bytes[b];
+			h *= 1099511628211ULL;
+		}
+	}
+	return h;
+}
+
+//Mesh BVHs kept between strokes, one per shape (and one per placement for shapes whose
+//placement had to be baked in). A dirty callback on each shape flags it, so only meshes that
+//may have changed are hashed again at the next press.
+struct StrokeSession::MeshCache {
+	struct Entry {
+		MObjectHandle shape;
+		MString bakedPath; //empty unless the world matrix is baked into the points
+		MMatrix bakedMatrix;
+		MCallbackId dirtyCallback;
+		std::atomic<bool> dirty;
+		unsigned long long hash;
+		std::shared_ptr<MeshBVH> bvh;
+	};
+	std::vector<std::unique_ptr<Entry> > entries;
+
+	//what the current scene was built from, to keep it when nothing changed
+	std::vector<const MeshBVH*> sceneMeshes;
+	std::vector<MMatrix> sceneMatrices;
+
+	~MeshCache() {
+		for (size_t i = 0; i < entries.size(); i++) MMessage::removeCallback(entries[i]->dirtyCallback);
+	}
+
+	static void meshDirty(MObject&, void* clientData) {
+		static_cast<Entry*>(clientData)->dirty = true;
+	}
+
+	Entry* find(MObject& shape, const MString& bakedPath) {
+		for (size_t i = 0; i < entries.size(); i++) {
+			if (entries[i]->shape == shape && entries[i]->bakedPath == bakedPath) return entries[i].get();
+		}
+		std::unique_ptr<Entry> entry(new Entry());
+		entry->shape = MObjectHandle(shape);
+		entry->bakedPath = bakedPath;
+		entry->dirty = true;
+		entry->hash = 0;
+		entry->dirtyCallback = MNodeMessage::addNodeDirtyCallback(shape, meshDirty, entry.get());
+		entries.push_back(std::move(entry));
+		return entries.back().get();
+	}
+
+	//forget shapes that were deleted
+	void prune() {
+		for (size_t i = 0; i < entries.size();) {
+			if (entries[i]->shape.isValid()) { i++; continue; }
+			MMessage::removeCallback(entries[i]->dirtyCallback);
+			entries.erase(entries.begin() + i);
+		}
+	}
+};
+
+MStatus StrokeSession::begin() {
+	MStatus s;
+	valid = false;
+	if (!cache) cache.reset(new MeshCache());
+	cache->prune();
+
+	//every visible, final mesh; instances come through once per path
+	MItDag itr(MItDag::kDepthFirst, MFn::kMesh, &s);
+	if (s != MStatus::kSuccess) return s;
+
+	std::vector<MDagPath> found;
+	std::vector<std::shared_ptr<const MeshBVH> > meshes;
+	std::vector<Similarity> placements;
+	std::vector<MMatrix> matrices;
+	for (; !itr.isDone(); itr.next()) {
+		MDagPath path;
+		if (itr.getPath(path) != MStatus::kSuccess) continue;
+		MFnDagNode dagNode(path);
+		if (dagNode.isIntermediateObject() || !path.isVisible()) continue;
+
+		std::shared_ptr<const MeshBVH> mesh;
+		Similarity placement;
+		if (rebuild(path, mesh, placement) != MStatus::kSuccess || mesh->empty()) continue;
+		found.push_back(path);
+		meshes.push_back(mesh);
+		placements.push_back(placement);
+		matrices.push_back(path.inclusiveMatrix());
+	}
+	if (meshes.empty()) return MS::kFailure;
+
+	//the top level is cheap, but a new one drops the distance field, so keep it if nothing moved
+	bool same = scene && meshes.size() == cache->sceneMeshes.size();
+	for (size_t i = 0; same && i < meshes.size(); i++) {
+		same = meshes[i].get() == cache->sceneMeshes[i] && matrices[i].isEquivalent(cache->sceneMatrices[i]);
+	}
+	if (!same) {
+		std::shared_ptr<SceneBVH> built(new SceneBVH());
+		cache->sceneMeshes.clear();
+		for (size_t i = 0; i < meshes.size(); i++) {
+			built->addMesh(meshes[i], placements[i]);
+			cache->sceneMeshes.push_back(meshes[i].get());
+		}
+		built->build();
+		cache->sceneMatrices = matrices;
+		scene = built;
+		sdf.reset();
+	}
+	paths = found;
+	if (sdfEnabled) rebuildDistanceField();
+
+	valid = true;
+	return MS::kSuccess;
+}
+
+//returns the BVH for the shape at path, built only if it is new or its points changed since
+//the last stroke. Rotations, translations and uniform scales place the shape's own BVH;
+//other placements are baked into a BVH of the world space points.
+MStatus StrokeSession::rebuild(const MDagPath& path, std::shared_ptr<const MeshBVH>& mesh, Similarity& placement) {
+	MStatus s;
+	MFnMesh fnMesh(path, &s);
+	if (s != MStatus::kSuccess) return s;
+
+	MMatrix world = path.inclusiveMatrix();
+	double m[4][4];
+	world.get(m);
+	bool similar = Similarity::fromMatrix(m, placement);
+	if (!similar) placement = Similarity();
+
+	MObject shape = path.node();
+	MeshCache::Entry* entry = cache->find(shape, similar ? MString() : path.fullPathName());
+	bool moved = !similar && !world.isEquivalent(entry->bakedMatrix);
+	if (entry->bvh && !entry->dirty && !moved) {
+		mesh = entry->bvh;
+		return MS::kSuccess;
+	}
+	entry->dirty = false;
+
+	MPointArray points;
+	s = fnMesh.getPoints(points, similar ? MSpace::kObject : MSpace::kWorld);
+	if (s != MStatus::kSuccess) return s;
+
+	unsigned long long h = hashPoints(points);
+	if (entry->bvh && h == entry->hash) {
+		entry->bakedMatrix = world;
+		mesh = entry->bvh;
+		return MS::kSuccess;
+	}
+
+	MIntArray triCounts, triVerts;
+	s = fnMesh.getTriangles(triCounts, triVerts);
+	if (s != MStatus::kSuccess) return s;
+
+	std::vector<Vec3> vertices(points.length());
+	for (unsigned i = 0; i < points.length(); i++) vertices[i] = toVec3(points[i]);
+	std::vector<int> triangles(triVerts.length());
+	for (unsigned i = 0; i < triVerts.length(); i++) triangles[i] = triVerts[i];
+
+	//a fresh object so anything still holding the old one keeps a consistent tree
+	std::shared_ptr<MeshBVH> built(new MeshBVH());
+	built->build(vertices, triangles);
+	entry->bvh = built;
+	entry->hash = h;
+	entry->bakedMatrix = world;
+	mesh = built;
+
+	MGlobal::displayInfo(MString("Built BVH for ") + path.partialPathName() + " over "
+		+ built->triangleCount() + " triangles");
+	return MS::kSuccess;
+}
+
+//(re)sample the field when the mesh or the requested resolution changed
+void StrokeSession::rebuildDistanceField() {
+	Vec3 ext = scene->bounds().extent();
+	double voxel = sdfVoxelSize > 0 ? sdfVoxelSize : length(ext) / 256;
+	double band = sdfBand > 0 ? sdfBand : sdfMinBand + 4 * voxel;
+	if (sdf && sdf->voxelSize() == voxel && sdf->bandWidth() == band) return;
+
+	ThreadPool serial(1);
+	std::shared_ptr<SparseSDF> built(new SparseSDF());
+	built->build(*scene, voxel, band, pool ? *pool : serial);
+	sdf = built;
+
+	MGlobal::displayInfo(MString("Built distance field: ") + (int)built->brickCount() + " bricks, "
+		+ (double)built->memoryBytes() / (1024.0 * 1024.0) + " MB");
+}
+
+void StrokeSession::end() {
+	valid = false;
+}
+
+void StrokeSession::meshQuery(const MPoint& p, int* hint, SceneHit& hit) const {
+	if (hint) {
+		scene->closestPointNear(toVec3(p), *hint, hit);
+		*hint = scene->sceneTriangle(hit);
+	} else {
+		scene->closestPoint(toVec3(p), hit);
+	}
+}
+
+MStatus StrokeSession::closestPoint(const MPoint& p, MPoint& closest, int* hint, int* mesh) const {
+	SceneHit hit;
+	meshQuery(p, hint, hit);
+	if (hit.mesh < 0) return MS::kFailure;
+	closest = toMPoint(hit.hit.point);
+	if (mesh) *mesh = hit.mesh;
+	return MS::kSuccess;
+}
+
+double StrokeSession::distance(const MPoint& p, int* hint) const {
+	//the field answers inside its band, the BVH everywhere else
+	double d;
+	if (sdf && sdf->sample(toVec3(p), d)) return std::fabs(d);
+
+	SceneHit hit;
+	meshQuery(p, hint, hit);
+	return hit.hit.distance;
+}
+
+double StrokeSession::distance(const MPoint& p, MVector& gradient, int* hint) const {
+	double d;
+	Vec3 g;
+	if (sdf && sdf->sample(toVec3(p), d, &g)) {
+		gradient = toMVector(d < 0 ? -g : g);
+		return std::fabs(d);
+	}
+
+	SceneHit hit;
+	meshQuery(p, hint, hit);
+	//on the surface itself the offset vanishes, fall back to the surface normal there
+	Vec3 offset = toVec3(p) - hit.hit.point;
+	gradient = toMVector(hit.hit.distance > 0 ? offset / hit.hit.distance : scene->pseudoNormal(hit));
+	return hit.hit.distance;
+}
+
+void StrokeSession::signedDistance(int count, const double* x, const double* y, const double* z, int* hints,
+	double* distance) const {
+	for (int i = 0; i < count; i++) {
+		Vec3 p(x[i], y[i], z[i]);
+		if (sdf && sdf->sample(p, distance[i])) continue;
+
+		SceneHit hit;
+		scene->closestPointNear(p, hints[i], hit);
+		if (hit.mesh < 0) {
+			distance[i] = 1e300;
+			continue;
+		}
+		hints[i] = scene->sceneTriangle(hit);
+		bool inside = dot(p - hit.hit.point, scene->pseudoNormal(hit)) < 0;
+		distance[i] = inside ? -hit.hit.distance : hit.hit.distance;
+	}
+}
+
+bool StrokeSession::intersects(const MPoint& origin, const MVector& direction) const {
+	return scene->intersects(toVec3(origin), toVec3(direction));
+}
+
+bool StrokeSession::raycast(const MPoint& origin, const MVector& direction, double& t, int* mesh) const {
+	SceneRayHit hit;
+	if (!scene->raycast(toVec3(origin), toVec3(direction), hit)) return false;
+	t = hit.hit.t;
+	if (mesh) *mesh = hit.mesh;
+	return true;
+}
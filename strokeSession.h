@@ -0,0 +1,80 @@
+#pragma once
+#include <maya\MDagPath.h>
+#include <maya\MString.h>
+#include <maya\MStatus.h>
+#include <maya\MPoint.h>
+#include <maya\MVector.h>
+#include <memory>
+#include <vector>
+#include "sceneBVH.h"
+#include "sparseSDF.h"
+#include "threadPool.h"
+
+//Owns every geometry query made while a single stroke is being drawn and optimized.
+//The scene's meshes are resolved once (at press) so the objective terms never touch the DAG.
+//Each mesh keeps its BVH between strokes until it changes; moving a mesh only moves it in
+//the top level hierarchy over all of them.
+//Between begin() and end() the const queries are Maya-free and safe to call from any thread.
+class StrokeSession {
+public:
+	StrokeSession();
+
+	//workers used for building acceleration structures
+	void setThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+
+	//optional narrow band distance field; voxelSize <= 0 picks one from the mesh size and
+	//band <= 0 covers minBand plus a few voxels. Takes effect at the next begin()
+	void setDistanceField(bool enabled, double voxelSize, double band, double minBand);
+	size_t distanceFieldMemory() const { return sdf ? sdf->memoryBytes() : 0; }
+
+	//gather every visible mesh to paint on; must be called from the main thread
+	MStatus begin();
+	void end();
+	bool isValid() const { return valid; }
+
+	//world space queries against the resolved meshes. hint, when given, is the scene triangle
+	//found by an earlier nearby query (or -1); the search starts there and it is updated with
+	//the answer. mesh, when given, receives the id of the mesh that was found
+	MStatus closestPoint(const MPoint& p, MPoint& closest, int* hint = 0, int* mesh = 0) const;
+	double distance(const MPoint& p, int* hint = 0) const;
+	//also returns the gradient of the (unsigned) distance, pointing away from the surface
+	double distance(const MPoint& p, MVector& gradient, int* hint = 0) const;
+	//signed distance (negative inside) at count points given as coordinate arrays, each with a
+	//hint as above; one call answers a whole batch of points
+	void signedDistance(int count, const double* x, const double* y, const double* z, int* hints,
+		double* distance) const;
+	bool intersects(const MPoint& origin, const MVector& direction) const;
+	//nearest hit along origin + t*direction, t >= 0
+	bool raycast(const MPoint& origin, const MVector& direction, double& t, int* mesh = 0) const;
+
+	int meshCount() const { return (int)paths.size(); }
+	//the shape a mesh id stands for
+	const MDagPath& meshPath(int mesh) const { return paths[mesh]; }
+	const SceneBVH& sceneBVH() const { return *scene; }
+	//identifies the scene data; a new one is built whenever any mesh changes or moves
+	std::shared_ptr<const SceneBVH> sceneHandle() const { return scene; }
+
+private:
+	struct MeshCache;
+
+	MStatus rebuild(const MDagPath& path, std::shared_ptr<const MeshBVH>& mesh, Similarity& placement);
+	void rebuildDistanceField();
+	void meshQuery(const MPoint& p, int* hint, SceneHit& hit) const;
+
+	bool valid;
+	ThreadPool* pool;
+
+	//per mesh BVHs and their dirty callbacks; only touched on the main thread
+	std::shared_ptr<MeshCache> cache;
+	std::shared_ptr<SceneBVH> scene;
+	std::vector<MDagPath> paths; //by mesh id
+
+	std::shared_ptr<SparseSDF> sdf;
+	bool sdfEnabled;
+	double sdfVoxelSize, sdfBand, sdfMinBand;
+};
+
+inline Vec3 toVec3(const MPoint& p) { return Vec3(p.x, p.y, p.z); }
+inline Vec3 toVec3(const MVector& v) { return Vec3(v.x, v.y, v.z); }
+inline MPoint toMPoint(const Vec3& v) { return MPoint(v.x, v.y, v.z); }
+inline MVector toMVector(const Vec3& v) { return MVector(v.x, v.y, v.z); }
@@ -0,0 +1,708 @@
+#include "strokeSolver.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "bandedMatrix.h"
+
+const float kMaxError = 0.05;
+//initializeT controls: hard cap on distance queries per ray, and how close to the level set
+//(in world units) Newton steps take over from sphere steps
+const int kMaxInitIterations = 100;
+const float kNewtonBand = 0.5;
+//refinePoint descent controls
+const float kInitialStepRate = 0.5;
+const float kMinStepRate = 1e-6;
+const float kGradientTolerance = 1e-9;
+const int kMaxRefineIterations = 100;
+//relative weights of the objective terms, per the paper
+const float kLevelAngleWeight = 0.1;
+const float kFurLengthWeight = 0.1;
+const float kFeatherRootAngleWeight = 2;
+//joint (Levenberg-Marquardt) solver controls
+const int kMaxSolverIterations = 20;
+//its step limit at the default tolerance; the tolerance scales it from there
+const double kSolverStepTolerance = 1e-5;
+const double kDefaultTolerance = 1e-4;
+//sweeps of the pointwise and parallel refinements
+const int kMaxSweeps = 50;
+//descent steps per ray in each pointwise sweep
+const int kSweepIterations = 10;
+//rays re-refined each time a LevelMode ray is added; everything older stays put
+const int kRefineWindow = 8;
+//resolvePenetration controls: rounds of queries, points per batched query, and the distance a
+//pushed point is left above the surface, as a fraction of its stroke's root to tip distance
+const int kMaxPushRounds = 4;
+const int kPushGrain = 256;
+const double kPushClearance = 1e-3;
+
+StrokeSolver::StrokeSolver()
+{
+	pool = 0;
+	mode = LevelMode;
+	optimizer = PointwiseOptimizer;
+	startLevel = 0;
+	endLevel = 0;
+	timeBudget = 0;
+	tolerance = 1e-4;
+	angleWeight = kLevelAngleWeight;
+	lengthWeight = kFurLengthWeight;
+	errorWeight = 1;
+	outOfTime = false;
+	initializedRays = 0;
+	initFailures = 0;
+	pushedRays = 0;
+}
+
+void StrokeSolver::begin(const StrokeSession& strokeSession, ThreadPool* threadPool, const StrokeSettings& settings) {
+	session = strokeSession;
+	pool = threadPool;
+	mode = settings.mode;
+	optimizer = settings.optimizer;
+	startLevel = settings.startLevel;
+	endLevel = settings.endLevel;
+	timeBudget = settings.timeBudget;
+	tolerance = settings.tolerance;
+	//straightness only counts a tenth against the level set, but carries fur and feathers
+	angleWeight = (mode == LevelMode ? kLevelAngleWeight : 1) * settings.angleWeight;
+	lengthWeight = kFurLengthWeight * settings.lengthWeight;
+	errorWeight = settings.errorWeight;
+	outOfTime = false;
+	rays.clear();
+	initializedRays = 0;
+	initFailures = 0;
+	pushedRays = 0;
+	prior.clear();
+	firstTrace.clear();
+	lastTrace.clear();
+}
+
+//The first ray sits on the start level in every mode, so it is placed right away. In LevelMode
+//every ray only depends on the ones before it, so each new one is placed as soon as it arrives
+//and the last kRefineWindow rays are refined again; solve() then only has to finish the tail.
+//Fur and feathers are initialized from their tip, so the rest waits for solve().
+//Each ray starts its search as deep as the free space traced by its predecessor (or, for the
+//first, by recent strokes) allows, and its mesh queries start at the predecessor's triangle.
+void StrokeSolver::addRay(const MPoint& origin, const MVector& direction) {
+	rays.push_back(origin, direction);
+	if (!session.isValid()) return;
+
+	int n = rays.size();
+	if (n > 1 && mode != LevelMode) return;
+	if (n > 1) rays.tri[n - 1] = rays.tri[n - 2];
+	FreeSpace trace;
+	if (initializeT(n - 1, false, n > 1 ? &lastTrace : &prior, &trace) == InitBudgetExceeded) initFailures++;
+	lastTrace = std::move(trace);
+	if (n == 1) firstTrace = lastTrace;
+	initializedRays = n;
+	if (n > 1) {
+		for (int i = std::max(0, n - kRefineWindow); i < n; i++) refinePoint(i);
+	}
+}
+
+//Runs on the pool, or inline when the stroke is one of a batch already spread over it
+void StrokeSolver::forEach(int count, const std::function<void(int)>& fn, int grain) {
+	if (pool) pool->parallelFor(count, fn, grain);
+	else for (int i = 0; i < count; i++) fn(i);
+}
+
+//Never true without a budget
+bool StrokeSolver::pastDeadline() {
+	if (timeBudget > 0 && std::chrono::steady_clock::now() > deadline) outOfTime = true;
+	return outOfTime;
+}
+
+std::chrono::steady_clock::time_point StrokeSolver::deadlineFromNow() const {
+	return std::chrono::steady_clock::now()
+		+ std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeBudget));
+}
+
+void StrokeSolver::solve() {
+	solve(deadlineFromNow());
+}
+
+void StrokeSolver::solve(std::chrono::steady_clock::time_point until) {
+	if (rays.empty() || !session.isValid()) return;
+	outOfTime = false;
+	deadline = until;
+	initializeCurve();
+
+	if (optimizer == OptimizerType::JointOptimizer) {
+		//every t at once
+		solveCurve();
+	} else if (optimizer == OptimizerType::ParallelOptimizer) {
+		//independent classes of rays concurrently, until the whole stroke settles
+		refineParallel();
+	} else {
+		//go through each ray, starting at the 'root' point, and optimize piecemeal.
+		//In LevelMode addRay already refined everything but the last window.
+		refineSweeps(mode == LevelMode ? std::max(0, rays.size() - kRefineWindow) : 0);
+	}
+}
+
+//Every interior point of the batch's fur and feathers is classified together, a chunk of points
+//per signed distance call. A point found inside is cast back toward the eye and moved just past
+//where its ray leaves the surface, so the strand stays under the cursor. Only moved points are
+//classified again, which matters where meshes overlap; one round settles the rest. Should the
+//cast find nothing (an open mesh), the point steps back by its depth instead, as a sphere trace.
+void StrokeSolver::resolvePenetration(std::vector<StrokeSolver>& strokes, ThreadPool* pool) {
+	//the strokes of a batch are begun from the same session, so its scene answers for all
+	const StrokeSolver* shared = 0;
+	std::vector<double> clearance(strokes.size(), 0.0);
+	std::vector<int> owner, ray, hints;
+	for (int s = 0; s < (int)strokes.size(); s++) {
+		StrokeSolver& stroke = strokes[s];
+		stroke.pushedRays = 0;
+		int n = stroke.rays.size();
+		if ((stroke.mode != FurMode && stroke.mode != FeatherMode) || !stroke.isValid() || n < 3) continue;
+		if (!shared) shared = &stroke;
+		if (stroke.session.sceneHandle() != shared->session.sceneHandle()) continue;
+		clearance[s] = kPushClearance * (stroke.rays.point(n - 1) - stroke.rays.point(0)).length();
+		for (int i = 1; i < n - 1; i++) {
+			owner.push_back(s);
+			ray.push_back(i);
+			hints.push_back(stroke.rays.tri[i]);
+		}
+	}
+	if (owner.empty()) return;
+
+	std::vector<int> active(owner.size());
+	for (size_t k = 0; k < active.size(); k++) active[k] = (int)k;
+	std::vector<double> x, y, z, distance;
+	std::vector<int> chunkHints;
+	std::vector<char> inside, moved(owner.size(), 0);
+	for (int round = 0; round < kMaxPushRounds && !active.empty(); round++) {
+		int n = (int)active.size();
+		x.resize(n); y.resize(n); z.resize(n);
+		distance.resize(n);
+		chunkHints.resize(n);
+		inside.assign(n, 0);
+		int chunks = (n + kPushGrain - 1) / kPushGrain;
+		std::function<void(int)> pushChunk = [&](int c) {
+			int first = c * kPushGrain, last = std::min(n, first + kPushGrain);
+			for (int j = first; j < last; j++) {
+				int k = active[j];
+				const RayBuffer& rays = strokes[owner[k]].rays;
+				int i = ray[k];
+				x[j] = rays.ox[i] + rays.t[i] * rays.dx[i];
+				y[j] = rays.oy[i] + rays.t[i] * rays.dy[i];
+				z[j] = rays.oz[i] + rays.t[i] * rays.dz[i];
+				chunkHints[j] = hints[k];
+			}
+			shared->session.signedDistance(last - first, &x[first], &y[first], &z[first], &chunkHints[first], &distance[first]);
+			for (int j = first; j < last; j++) {
+				int k = active[j];
+				hints[k] = chunkHints[j];
+				if (distance[j] >= 0) continue;
+				RayBuffer& rays = strokes[owner[k]].rays;
+				int i = ray[k];
+				Vec3 back(-rays.dx[i], -rays.dy[i], -rays.dz[i]);
+				double speed = length(back);
+				if (!(speed > 0) || rays.t[i] <= 0) continue;
+				SceneRayHit exit;
+				double step = shared->session.sceneBVH().raycast(Vec3(x[j], y[j], z[j]), back, exit)
+					? exit.hit.t + clearance[owner[k]] / speed
+					: (clearance[owner[k]] - distance[j]) / speed;
+				rays.t[i] = (float)std::max(0.0, rays.t[i] - step);
+				rays.tri[i] = hints[k];
+				moved[k] = 1;
+				inside[j] = 1;
+			}
+		};
+		if (pool) pool->parallelFor(chunks, pushChunk);
+		else for (int c = 0; c < chunks; c++) pushChunk(c);
+
+		std::vector<int> next;
+		for (int j = 0; j < n; j++) {
+			if (inside[j]) next.push_back(active[j]);
+		}
+		active.swap(next);
+	}
+
+	for (size_t k = 0; k < owner.size(); k++) strokes[owner[k]].pushedRays += moved[k];
+}
+
+//Passes over rays first..n-1, each giving every ray a few descent steps, so the whole stroke
+//improves together and stopping at the deadline never leaves its tail untouched
+void StrokeSolver::refineSweeps(int first) {
+	for (int sweep = 0; sweep < kMaxSweeps; sweep++) {
+		float maxChange = 0;
+		for (int i = first; i < rays.size(); i++) {
+			float before = rays.t[i];
+			refinePoint(i, kSweepIterations);
+			maxChange = std::max(maxChange, std::fabs(rays.t[i] - before));
+		}
+		if (maxChange < tolerance || pastDeadline()) break;
+	}
+}
+
+//d/dt of (1 - s*(a . v/|v|))^2 where v moves along dir as t changes and a is a fixed unit vector
+static float angleDerivative(const MVector& a, const MVector& v, const MVector& dir, float s) {
+	double len = v.length();
+	if (len <= 0) return 0;
+	MVector n = v / len;
+	double dot = a * n;
+	//derivative of the normalized segment, projected onto a
+	double dn = (a * dir - dot * (n * dir)) / len;
+	return -2 * (1 - s * dot) * s * dn;
+}
+
+//Converging (FINALLY!!!!!)
+//Each term also reports its derivative with respect to rays.t[index] through dt when asked
+float StrokeSolver::angleTerm(int index, float* dt) {
+	float output = 0;
+	float dot;
+	MPoint p1,p2,p3;
+	MVector v1, v2;
+	if (dt) *dt = 0;
+
+	//for the first point of a non-level-set stroke, we want to use a control point
+	if (mode != ModeType::LevelMode && index == 1) {
+		p2 = rays.point(0); p3 = rays.point(1);
+		//p1 is now on the mesh surface; the root's hint is only read here, its own refinement updates it
+		int rootHint = rays.tri[0];
+		session.closestPoint(p2, p1, &rootHint);
+
+		if (mode == ModeType::FurMode) {
+			//prepend a control point (p1) directly toward the mesh from where we are
+			v1 = p2 - p1; v2 = p3 - p2;
+			dot = v1.normal() * v2.normal();
+			//assess cost of first angle based on the existence of that point
+			output += pow(1 - dot, 2);
+			if (dt) *dt += angleDerivative(v1.normal(), v2, rays.direction(1), 1);
+		}
+		else if (mode == ModeType::FeatherMode) {
+			//we want the cross of the point-to-surface and (the point-to-surface and the point-to-last-point)
+			v1 = (p1 - p2) ^ ((p1 - p2) ^ (rays.point(rays.size() - 1) - p2)); v2 = p3 - p2;
+			dot = -(v1.normal()) * v2.normal();
+			//again, always calculate that first dot
+			output += pow(1 - dot, 2) * kFeatherRootAngleWeight;
+			//v1 only moves with t when the stroke is two rays long, which is ignored here
+			if (dt) *dt += angleDerivative(v1.normal(), v2, rays.direction(1), -1) * kFeatherRootAngleWeight;
+		}
+	} 
+	
+	//for the interior points of every stroke, we optimize for straightness
+	else if (index > 1 && index < rays.size()) {
+		//get unit vectors representing consecutive stroke segments
+		p1 = rays.point(index-2); p2 = rays.point(index-1); p3 = rays.point(index);
+		v1 = p2 - p1; v2 = p3 - p2;
+		dot = v1.normal() * v2.normal();
+
+		//output the 'cost': 0 = parallel... 1 = orthogonal
+		output += pow(1 - dot, 2);
+		if (dt) *dt += angleDerivative(v1.normal(), v2, rays.direction(index), 1);
+	}
+	return output;
+}
+float StrokeSolver::lengthTerm(int index, float* dt) {
+	float output = 0;
+	MPoint p = rays.point(index);
+	MVector dir = rays.direction(index);
+	if (dt) *dt = 0;
+	if (index > 0) {
+		MVector v = p - rays.point(index - 1);
+		output += v * v;
+		if (dt) *dt += 2 * (v * dir);
+	}
+	if (index < rays.size() - 1) {
+		MVector v = p - rays.point(index + 1);
+		output += v * v;
+		if (dt) *dt += 2 * (v * dir);
+	}
+	return output;
+}
+float StrokeSolver::errorTerm(int index, float* dt) {
+	float output = 0;
+	float level;
+	if (dt) *dt = 0;
+
+	//check the error for all level points, or the first point of fur/feather
+	if (mode == ModeType::LevelMode || index == 0) level = startLevel + 0.001;
+
+	//check error for last point of fur/feather (uses end level)
+	else if (index == rays.size() - 1) level = endLevel;
+	else return output;
+
+	//the distance gradient is the unit vector from the closest point, so one query gives both
+	MVector gradient;
+	float error = session.distance(rays.point(index), gradient, &rays.tri[index]) - level;
+	output += pow(error, 2);
+	if (dt) *dt += 2 * error * (gradient * rays.direction(index));
+	return output;
+}
+
+//Assess all three objective functions and weight each as prescribed in paper (times the tool's multipliers)
+//dt receives d(objective)/d(rays.t[i]) when given
+float StrokeSolver::assessObj(int i, float* dt) {
+	float da, dl, de;
+	float output;
+
+	switch (mode) {
+	case ModeType::LevelMode:
+		output = errorTerm(i, dt ? &de : 0) * errorWeight + angleTerm(i, dt ? &da : 0) * angleWeight;
+		if (dt) *dt = de * errorWeight + da * angleWeight;
+		return output;
+	case ModeType::FeatherMode:
+	case ModeType::FurMode:
+		if (i == 0) { //root, must lie on desired level set for intelligibility
+			output = errorTerm(i, dt) * errorWeight;
+			if (dt) *dt *= errorWeight;
+			return output;
+		}
+		//interior fur/feather wont affect error, dont compute
+		output = angleTerm(i, dt ? &da : 0) * angleWeight + lengthTerm(i, dt ? &dl : 0) * lengthWeight;
+		if (dt) *dt = da * angleWeight + dl * lengthWeight;
+		return output;
+	default:
+		//unreachable: the context rejects other modes before handing a stroke over
+		if (dt) *dt = 0;
+		return 0;
+	}
+}
+
+//Descent on t with the analytic derivative: one objective evaluation (and so one mesh query)
+//per step. The step grows while it keeps paying off and is halved whenever it overshoots.
+void StrokeSolver::refinePoint(int i, int maxIterations) {
+	float grad, newGrad;
+	float rate = kInitialStepRate;
+	float currentObj = assessObj(i, &grad);
+
+	for (int iter = 0; iter < maxIterations; iter++) {
+		if (pow(grad, 2) < kGradientTolerance || rate < kMinStepRate) break;
+
+		float oldT = rays.t[i];
+		rays.t[i] -= rate * grad;
+		float newObj = assessObj(i, &newGrad);
+
+		if (newObj > currentObj) {
+			//overshot: go back and try a shorter step along the same gradient
+			rays.t[i] = oldT;
+			rate *= 0.5;
+			continue;
+		}
+		currentObj = newObj;
+		grad = newGrad;
+		rate *= 1.5;
+	}
+}
+
+void StrokeSolver::refinePoint(int i) {
+	refinePoint(i, kMaxRefineIterations);
+}
+
+//Adds w*r^2 to cost and, when assembling, the residual's share of J^T J and J^T r.
+//idx/J list the (at most 3 consecutive) rays the residual depends on and dr/dt for each.
+static void addResidual(double r, const int* idx, const double* J, int count, double w,
+	double& cost, BandedMatrix* JtJ, std::vector<double>* Jtr) {
+	cost += w * r * r;
+	if (!JtJ) return;
+	for (int a = 0; a < count; a++) {
+		(*Jtr)[idx[a]] += w * J[a] * r;
+		for (int b = 0; b <= a; b++) JtJ->at(idx[a], idx[b]) += w * J[a] * J[b];
+	}
+}
+
+//d(n . v/|v|)/dt for v = hi - lo, when the ray behind one end moves along dir (sign = +1 for hi, -1 for lo)
+static double normalDerivative(const MVector& n, const MVector& v, const MVector& dir, double sign) {
+	double len = v.length();
+	if (len <= 0) return 0;
+	MVector u = v / len;
+	return sign * (n * dir - (n * u) * (u * dir)) / len;
+}
+
+//The full stroke objective (the sum of assessObj over every ray) written as weighted squared
+//residuals. Every residual touches at most rays i-2..i, so J^T J is pentadiagonal.
+//Returns the objective; fills JtJ and Jtr too when they are given.
+double StrokeSolver::curveObjective(BandedMatrix* JtJ, std::vector<double>* Jtr) {
+	int n = (int)rays.size();
+	double cost = 0;
+	int idx[3];
+	double J[3];
+	if (JtJ) {
+		JtJ->setZero();
+		Jtr->assign(n, 0.0);
+	}
+
+	std::vector<MPoint> pts(n);
+	for (int i = 0; i < n; i++) pts[i] = rays.point(i);
+
+	//level set error: every ray in LevelMode, only the root for fur and feathers
+	int errorCount = mode == ModeType::LevelMode ? n : 1;
+	for (int i = 0; i < errorCount; i++) {
+		MVector gradient;
+		double r = session.distance(pts[i], gradient, &rays.tri[i]) - startLevel - 0.001;
+		idx[0] = i; J[0] = gradient * rays.direction(i);
+		addResidual(r, idx, J, 1, errorWeight, cost, JtJ, Jtr);
+	}
+
+	//interior straightness, angle at ray i-1
+	for (int i = 2; i < n; i++) {
+		MVector v1 = pts[i - 1] - pts[i - 2], v2 = pts[i] - pts[i - 1];
+		MVector n1 = v1.normal(), n2 = v2.normal();
+		idx[0] = i - 2; idx[1] = i - 1; idx[2] = i;
+		J[0] = -normalDerivative(n2, v1, rays.direction(i - 2), -1);
+		J[1] = -normalDerivative(n2, v1, rays.direction(i - 1), 1) - normalDerivative(n1, v2, rays.direction(i - 1), -1);
+		J[2] = -normalDerivative(n1, v2, rays.direction(i), 1);
+		addResidual(1 - n1 * n2, idx, J, 3, angleWeight, cost, JtJ, Jtr);
+	}
+
+	if (mode == ModeType::LevelMode || n < 2) return cost;
+
+	//root angle against the control point on the surface; the control direction is held
+	//fixed for the step (it only turns as the root slides along the surface)
+	MPoint onSurface;
+	session.closestPoint(pts[0], onSurface, &rays.tri[0]);
+	MVector control, v2 = pts[1] - pts[0];
+	double w = angleWeight;
+	if (mode == ModeType::FurMode) {
+		control = (pts[0] - onSurface).normal();
+	} else {
+		control = -(((onSurface - pts[0]) ^ ((onSurface - pts[0]) ^ (pts[n - 1] - pts[0]))).normal());
+		w *= kFeatherRootAngleWeight;
+	}
+	idx[0] = 0; idx[1] = 1;
+	J[0] = -normalDerivative(control, v2, rays.direction(0), -1);
+	J[1] = -normalDerivative(control, v2, rays.direction(1), 1);
+	addResidual(1 - control * v2.normal(), idx, J, 2, w, cost, JtJ, Jtr);
+
+	//segment lengths; lengthTerm counts each segment from both ends except at the root
+	for (int i = 1; i < n; i++) {
+		MVector v = pts[i] - pts[i - 1];
+		double segmentWeight = lengthWeight * (i > 1 ? 2 : 1);
+		idx[0] = i - 1; idx[1] = i;
+		for (int c = 0; c < 3; c++) {
+			J[0] = -rays.direction(i - 1)[c];
+			J[1] = rays.direction(i)[c];
+			addResidual(v[c], idx, J, 2, segmentWeight, cost, JtJ, Jtr);
+		}
+	}
+	return cost;
+}
+
+//The same objective as the sum of assessObj over every ray, evaluated for the whole stroke at
+//once: angle and length terms come from the batch kernels, level errors from parallel queries.
+double StrokeSolver::strokeObjective() {
+	int n = rays.size();
+	if (n == 0) return 0;
+	evaluateStrokeTerms(n, &rays.ox[0], &rays.oy[0], &rays.oz[0],
+		&rays.dx[0], &rays.dy[0], &rays.dz[0], &rays.t[0], terms);
+
+	if (mode == ModeType::LevelMode) {
+		std::vector<double> errors(n);
+		forEach(n, [&](int i) {
+			double e = session.distance(MPoint(terms.px[i], terms.py[i], terms.pz[i]), &rays.tri[i]) - startLevel - 0.001;
+			errors[i] = e * e;
+		}, 16);
+		return errorWeight * weightedSum(n, &errors[0], 0) + angleWeight * weightedSum(n, &terms.angle[0], 0);
+	}
+
+	//fur and feathers: root error, the root's control angle, then interior angle and length
+	double output = errorWeight * errorTerm(0);
+	if (n > 1) {
+		output += angleWeight * (angleTerm(1) + weightedSum(n - 2, terms.angle.data() + 2, 0));
+		output += lengthWeight * weightedSum(n - 1, terms.length.data() + 1, 0);
+	}
+	return output;
+}
+
+//Levenberg-Marquardt over every t at once. Each iteration assembles and factors the
+//pentadiagonal normal equations in O(n), so a handful of steps shape the whole stroke.
+void StrokeSolver::solveCurve() {
+	int n = (int)rays.size();
+	if (n == 0) return;
+
+	BandedMatrix JtJ(n, 2);
+	std::vector<double> Jtr, step, oldT(n);
+	double lambda = 1e-3;
+	double cost = curveObjective(&JtJ, &Jtr);
+	double stepTolerance = kSolverStepTolerance * tolerance / kDefaultTolerance;
+
+	for (int iter = 0; iter < kMaxSolverIterations; iter++) {
+		//damp with the diagonal so steps scale with each ray's own curvature
+		BandedMatrix damped = JtJ;
+		for (int i = 0; i < n; i++) damped.at(i, i) += lambda * (JtJ.at(i, i) + 1e-9);
+		step.resize(n);
+		for (int i = 0; i < n; i++) step[i] = -Jtr[i];
+		if (!damped.solve(step)) {
+			lambda *= 10;
+			continue;
+		}
+
+		double maxStep = 0;
+		for (int i = 0; i < n; i++) {
+			oldT[i] = rays.t[i];
+			rays.t[i] += step[i];
+			maxStep = std::max(maxStep, std::fabs(step[i]));
+		}
+
+		double newCost = strokeObjective();
+		if (newCost < cost) {
+			lambda = std::max(lambda / 3, 1e-9);
+			cost = curveObjective(&JtJ, &Jtr);
+			if (maxStep < stepTolerance) break;
+		} else {
+			for (int i = 0; i < n; i++) rays.t[i] = oldT[i];
+			lambda *= 4;
+			if (maxStep < stepTolerance) break;
+		}
+		if (pastDeadline()) break;
+	}
+}
+
+//Jacobi-style sweeps of refinePoint that can run concurrently. refinePoint(i) only reads rays
+//i-2..i+1 (plus both ends of the stroke), so interior rays whose indices are equal mod 3 never
+//read each other. Each class is refined in parallel while the rest stay fixed, which makes the
+//result independent of the thread count. Sweeps repeat until no t moves more than the tolerance.
+void StrokeSolver::refineParallel() {
+	int n = (int)rays.size();
+	if (n < 4) {
+		for (int i = 0; i < n; i++) refinePoint(i);
+		return;
+	}
+
+	std::vector<float> change(n, 0);
+	std::vector<int> members;
+	for (int sweep = 0; sweep < kMaxSweeps; sweep++) {
+		//the ends are read by rays of every class, so they move on their own
+		int ends[2] = { 0, n - 1 };
+		for (int e = 0; e < 2; e++) {
+			float before = rays.t[ends[e]];
+			refinePoint(ends[e]);
+			change[ends[e]] = std::fabs(rays.t[ends[e]] - before);
+		}
+
+		for (int colour = 0; colour < 3 && !pastDeadline(); colour++) {
+			members.clear();
+			for (int i = 1 + colour; i < n - 1; i += 3) members.push_back(i);
+			forEach((int)members.size(), [&](int m) {
+				int i = members[m];
+				float before = rays.t[i];
+				refinePoint(i);
+				change[i] = std::fabs(rays.t[i] - before);
+			}, 4);
+		}
+
+		float maxChange = *std::max_element(change.begin(), change.end());
+		if (maxChange < tolerance || outOfTime) break;
+	}
+}
+
+//Places ray i where the distance to the mesh first equals the level (the end level if end).
+//f(t) = distance - level is sphere traced from the current t: a step of f never passes the
+//first crossing. Close to the surface the step switches to Newton on f, kept inside the
+//bracket [last point outside, first mesh hit]. Rays that never get within the level stop
+//at their closest approach. Every path is bounded by kMaxInitIterations.
+//With a seed the trace starts as far along the ray as the seed's balls stay clear of the level
+//set, which can't pass the first crossing; trace collects the balls this ray measured or used.
+InitStatus StrokeSolver::initializeT(int i, bool end, const FreeSpace* seed, FreeSpace* trace) {
+	float level = end ? endLevel : startLevel;
+	MPoint origin = rays.origin(i);
+	MVector dir = rays.direction(i);
+	double speed = dir.length();
+	if (speed <= 0) return InitMissed;
+
+	//the mesh hit bounds the search from above when there is one
+	double hi;
+	bool hits = session.raycast(origin, dir, hi);
+	double start = rays.t[i];
+	double lo = start;
+	//keep kMaxError clear of the level so the seed itself is never taken as converged early
+	if (seed) lo = seed->reach(toVec3(origin), toVec3(dir), start, level + kMaxError, trace);
+	bool seeded = lo > start;
+	double t = lo;
+	double lastT = t, lastSlope = -1;
+
+	for (int iter = 0; iter < kMaxInitIterations; iter++) {
+		MVector gradient;
+		MPoint p = origin + dir * t;
+		double f = session.distance(p, gradient, &rays.tri[i]) - level;
+		double slope = gradient * dir; //df/dt
+		if (trace) trace->add(toVec3(p), f + level);
+
+		if (seeded && (f < 0 || (!hits && slope >= 0))) {
+			//the distance field disagrees with the seed, or the closest approach of a ray that
+			//misses may lie behind it: trace from the start as if there were no seed
+			seeded = false;
+			t = lo = lastT = start;
+			lastSlope = -1;
+			continue;
+		}
+
+		if (std::fabs(f) < kMaxError || (t == start && f < 0)) {
+			rays.t[i] = t;
+			return InitConverged;
+		}
+
+		if (f < 0) {
+			//only a Newton step can land inside; pull back toward the last outside point
+			hi = t;
+			hits = true;
+			double newton = t - f / slope;
+			t = (slope < 0 && newton > lo && newton < hi) ? newton : 0.5 * (lo + hi);
+			continue;
+		}
+
+		lo = t;
+		if (!hits && slope >= 0) {
+			//moving away without ever reaching the level: the closest approach lies between the
+			//last two samples, where the slope changes sign
+			double a = lastSlope < 0 ? lastT : t, b = t;
+			for (int k = iter; k < kMaxInitIterations && b - a > kMaxError / speed; k++) {
+				double mid = 0.5 * (a + b);
+				session.distance(origin + dir * mid, gradient, &rays.tri[i]);
+				if (gradient * dir < 0) a = mid;
+				else b = mid;
+			}
+			rays.t[i] = 0.5 * (a + b);
+			return InitMissed;
+		}
+
+		lastT = t; lastSlope = slope;
+		double next = t + f / speed;
+		//near the level set Newton converges much faster than sphere steps on grazing rays
+		if (f < kNewtonBand && slope < 0) next = std::max(next, t - f / slope);
+		if (hits && next >= hi) next = 0.5 * (t + hi);
+		t = next;
+	}
+
+	//out of budget: keep the last point known to be outside the level set
+	rays.t[i] = lo;
+	return InitBudgetExceeded;
+}
+
+//Places every ray not already initialized while dragging
+void StrokeSolver::initializeCurve() {
+
+	std::vector<InitStatus> status(rays.size(), InitConverged);
+
+	if (mode == LevelMode) {
+		//determine t values for every remaining i; rays are independent and the session queries
+		//are thread safe, so they are spread over the pool
+		int first = initializedRays;
+		forEach((int)rays.size() - first, [this, &status, first](int i) {
+			status[first + i] = initializeT(first + i);
+		}, 4);
+
+	//initialize hair or feathers
+	} else {
+		//determine t values for first (unless placed at press) and last i
+		if (initializedRays == 0) status[0] = initializeT(0);
+		status[rays.size() - 1] = initializeT(rays.size() - 1, true);
+
+		//EXPERIMENTAL
+		//create an intersection plane on which to project the linearly initialize points
+		MPoint P = rays.point(rays.size() - 1);
+		MVector R = rays.direction(rays.size() - 1); //~eye to last
+		MVector D = rays.point(0) - P; //last to first
+		MVector planeNormal = D ^ (R^D); // Borrowing the 'minimum skew plane' from secondSkin: D x (R x D)
+
+		for (int i = 1; i < rays.size() - 1; i++) {
+			//typical plane intersection to linearly position internals
+			rays.t[i] = ((P - rays.origin(i)) * planeNormal)
+						/ (rays.direction(i) * planeNormal);
+		}
+	}
+
+	initializedRays = rays.size();
+	initFailures += (int)std::count(status.begin(), status.end(), InitBudgetExceeded);
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <chrono>
+#include <maya\MPoint.h>
+#include <maya\MVector.h>
+#include "strokeSession.h"
+#include "threadPool.h"
+#include "rayBuffer.h"
+#include "strokeKernels.h"
+#include "freeSpace.h"
+
+enum ModeType {ErrorMode,LevelMode,FurMode,FeatherMode};
+
+//Pointwise refines one ray at a time in order, Joint solves for every ray's t together,
+//Parallel repeats pointwise refinement over independent sets of rays on the thread pool
+enum OptimizerType {PointwiseOptimizer,JointOptimizer,ParallelOptimizer};
+
+//Outcome of placing a ray on its level set: Missed means the ray never came within the level
+//and was left at its closest approach, BudgetExceeded means the search gave up
+enum InitStatus {InitConverged,InitMissed,InitBudgetExceeded};
+
+class BandedMatrix;
+
+//Tool settings a stroke is solved with, copied from the context at press
+struct StrokeSettings {
+	ModeType mode;
+	OptimizerType optimizer;
+	float startLevel, endLevel;
+	//seconds solve() may take, 0 for no limit; the stroke is always left in its best state so far
+	double timeBudget;
+	//shaping stops once no sweep moves any t further than this; the joint optimizer's step
+	//limit is a tenth of it
+	double tolerance;
+	//multipliers on the paper's angle, length and level set error weights
+	float angleWeight, lengthWeight, errorWeight;
+
+	StrokeSettings() : mode(LevelMode), optimizer(PointwiseOptimizer), startLevel(0), endLevel(0),
+		timeBudget(0), tolerance(1e-4), angleWeight(1), lengthWeight(1), errorWeight(1) {}
+};
+
+//The math of a single stroke: places its rays on their level sets and shapes them with the
+//chosen optimizer. It keeps its own rays and its own copy of the session (which shares the
+//cached mesh data), so a finished stroke can be solved on another thread while the next one
+//is drawn. Makes no Maya calls beyond the session's Maya-free queries.
+class StrokeSolver {
+public:
+	StrokeSolver();
+
+	//starts a new stroke with the tool settings at press; session must have begun. Without a
+	//pool everything runs on the calling thread, as for the strokes of a batch
+	void begin(const StrokeSession& session, ThreadPool* pool, const StrokeSettings& settings);
+	//free space measured by earlier strokes, used to start the first ray part way; set after begin
+	void setPrior(const FreeSpace& space) { prior = space; }
+	void addRay(const MPoint& origin, const MVector& direction);
+	//adds a ray without placing it, for strokes built all at once; solve() places it
+	void pushRay(const MPoint& origin, const MVector& direction) { rays.push_back(origin, direction); }
+	//places whatever addRay could not, then shapes the whole stroke until it settles or the
+	//time budget runs out, counted from now
+	void solve();
+	//the same against a deadline shared with other strokes, such as the strands of one spray;
+	//only checked when the stroke has a time budget
+	void solve(std::chrono::steady_clock::time_point until);
+	//when this stroke's time budget runs out if it starts now
+	std::chrono::steady_clock::time_point deadlineFromNow() const;
+	//pushes the interior points of fur and feather strokes that ended up inside a mesh back out
+	//along their rays, every stroke of a batch in the same rounds of batched queries; run after
+	//solve(). Only the initialization's ends carry level set terms, so the middle of a strand
+	//can dip into the surface. Without a pool everything runs on the calling thread
+	static void resolvePenetration(std::vector<StrokeSolver>& strokes, ThreadPool* pool);
+
+	bool isValid() const { return session.isValid(); }
+	ModeType strokeMode() const { return mode; }
+	const RayBuffer& rayBuffer() const { return rays; }
+	//leading rays already placed on their level set
+	int initializedCount() const { return initializedRays; }
+	//rays that ran out of iterations before reaching their level set
+	int failedCount() const { return initFailures; }
+	//true if the last solve() stopped at its time budget rather than converging
+	bool timedOut() const { return outOfTime; }
+	//interior points resolvePenetration moved out of the mesh
+	int pushedCount() const { return pushedRays; }
+	//what placing the first ray proved empty, for the strokes that follow
+	const FreeSpace& firstRayTrace() const { return firstTrace; }
+
+private:
+	void initializeCurve();
+	InitStatus initializeT(int i, bool end = false, const FreeSpace* seed = 0, FreeSpace* trace = 0);
+	float angleTerm(int i, float* dt = 0);
+	float lengthTerm(int i, float* dt = 0);
+	float errorTerm(int i, float* dt = 0);
+	float assessObj(int i, float* dt = 0);
+	void refinePoint(int i, int maxIterations);
+	void refinePoint(int i);
+	void refineSweeps(int first);
+	bool pastDeadline();
+	void forEach(int count, const std::function<void(int)>& fn, int grain = 1);
+	double strokeObjective();
+	double curveObjective(BandedMatrix* JtJ, std::vector<double>* Jtr);
+	void solveCurve();
+	void refineParallel();
+
+	RayBuffer rays;
+	StrokeTerms terms;
+	StrokeSession session;
+	ThreadPool* pool;
+	ModeType mode;
+	OptimizerType optimizer;
+	float startLevel, endLevel;
+	double timeBudget, tolerance;
+	//the paper's weights times the settings' multipliers
+	float angleWeight, lengthWeight, errorWeight;
+	std::chrono::steady_clock::time_point deadline;
+	bool outOfTime;
+	int initializedRays;
+	int initFailures;
+	int pushedRays;
+	//free space from earlier strokes, and that measured by the first and latest rays placed
+	FreeSpace prior, firstTrace, lastTrace;
+};
@@ -0,0 +1,123 @@
+//Times the mesh queries the optimizer makes on a character sized mesh: building the BVH, closest
+//point (plain and hinted along a stroke), ray casts, signed distance and the sparse distance
+//field, with brute force over every triangle for scale.
+//Usage: benchBVH [triangles, default 2000000] [queries, default 100000]
+#include "testing.h"
+#include "meshBVH.h"
+#include "sceneBVH.h"
+#include "sparseSDF.h"
+#include "threadPool.h"
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+
+static double seconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void report(const char* what, int queries, double elapsed) {
+	std::printf("%-28s %9d in %9.2f ms, %8.3f us each\n", what, queries, elapsed * 1000, elapsed * 1e6 / queries);
+}
+
+int main(int argc, char** argv) {
+	int wanted = argc > 1 ? std::atoi(argv[1]) : 2000000;
+	int queries = argc > 2 ? std::atoi(argv[2]) : 100000;
+	int rings = std::max(4, (int)std::sqrt(wanted / 4.0));
+
+	std::vector<Vec3> v;
+	std::vector<int> tris;
+	makeSphere(1.0, rings, 2 * rings, v, tris);
+	std::printf("sphere of %d triangles, %d queries\n", (int)tris.size() / 3, queries);
+
+	double start = seconds();
+	std::shared_ptr<MeshBVH> bvh(new MeshBVH);
+	bvh->build(v, tris);
+	report("build", 1, seconds() - start);
+	std::printf("%-28s %9.1f MB\n", "memory", bvh->memoryBytes() / (1024.0 * 1024.0));
+
+	//points within a tenth of the surface, as the level set optimizer asks for
+	std::mt19937 random(1);
+	std::uniform_real_distribution<double> shell(0.9, 1.1);
+	std::vector<Vec3> points(queries);
+	for (int q = 0; q < queries; q++) points[q] = randomDirection(random) * shell(random);
+	double sink = 0;
+
+	start = seconds();
+	for (int q = 0; q < queries; q++) {
+		ClosestHit hit;
+		bvh->closestPoint(points[q], hit);
+		sink += hit.distance;
+	}
+	report("closest point", queries, seconds() - start);
+
+	//a stroke: each query starts from the triangle the previous one found
+	std::vector<Vec3> path(queries);
+	for (int q = 0; q < queries; q++) {
+		double a = 20.0 * q / queries;
+		path[q] = normalize(Vec3(std::cos(a), std::sin(a), std::sin(3 * a) * 0.3)) * 1.05;
+	}
+	start = seconds();
+	int hint = -1;
+	for (int q = 0; q < queries; q++) {
+		ClosestHit hit;
+		bvh->closestPointNear(path[q], hint, hit);
+		hint = hit.triangle;
+		sink += hit.distance;
+	}
+	report("closest point, hinted", queries, seconds() - start);
+
+	start = seconds();
+	for (int q = 0; q < queries; q++) {
+		RayHit hit;
+		bvh->raycast(points[q] * 3, -points[q], hit);
+		sink += hit.t;
+	}
+	report("ray cast", queries, seconds() - start);
+
+	start = seconds();
+	for (int q = 0; q < queries; q++) sink += bvh->signedDistance(points[q]);
+	report("signed distance", queries, seconds() - start);
+
+	ThreadPool pool;
+	std::vector<double> distances(queries);
+	start = seconds();
+	pool.parallelFor(queries, [&](int q) { distances[q] = bvh->signedDistance(points[q]); }, 256);
+	char label[64];
+	std::snprintf(label, sizeof(label), "signed distance, %d threads", pool.threadCount());
+	report(label, queries, seconds() - start);
+
+	SceneBVH scene;
+	scene.addMesh(bvh, Similarity());
+	scene.build();
+	SparseSDF sdf;
+	start = seconds();
+	//a band as wide as the query shell, four voxels deep
+	sdf.build(scene, 0.025, 0.1, pool);
+	report("distance field build", 1, seconds() - start);
+	std::printf("%-28s %9.1f MB, %d bricks\n", "distance field memory", sdf.memoryBytes() / (1024.0 * 1024.0), (int)sdf.brickCount());
+	start = seconds();
+	int inBand = 0;
+	for (int q = 0; q < queries; q++) {
+		double d;
+		if (sdf.sample(points[q], d)) { sink += d; inBand++; }
+	}
+	report("distance field sample", queries, seconds() - start);
+
+	//brute force is far too slow for every query; a few give its rate
+	int few = std::max(1, std::min(queries, 20000000 / std::max(1, (int)tris.size() / 3)));
+	start = seconds();
+	for (int q = 0; q < few; q++) {
+		double best = 1e300;
+		for (size_t t = 0; t < tris.size(); t += 3) {
+			double a, b;
+			int feature;
+			Vec3 p = closestPointOnTriangle(points[q], v[tris[t]], v[tris[t + 1]], v[tris[t + 2]], a, b, feature);
+			best = std::min(best, length2(p - points[q]));
+		}
+		sink += best;
+	}
+	report("closest point, brute force", few, seconds() - start);
+
+	std::printf("(checksum %g, %d in band)\n", sink, inBand);
+	return 0;
+}
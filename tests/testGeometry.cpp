@@ -0,0 +1,248 @@
+//MeshBVH, SceneBVH and SparseSDF against brute force over the same triangles
+#include "testing.h"
+#include "meshBVH.h"
+#include "sceneBVH.h"
+#include "sparseSDF.h"
+#include "threadPool.h"
+#include <memory>
+
+//nearest distance to any of the triangles, the slow way
+static double bruteDistance(const std::vector<Vec3>& v, const std::vector<int>& tris, const Vec3& p) {
+	double best = 1e300;
+	for (size_t t = 0; t < tris.size(); t += 3) {
+		double u, w;
+		int feature;
+		Vec3 q = closestPointOnTriangle(p, v[tris[t]], v[tris[t + 1]], v[tris[t + 2]], u, w, feature);
+		best = std::min(best, length(q - p));
+	}
+	return best;
+}
+
+static double bruteRay(const std::vector<Vec3>& v, const std::vector<int>& tris, const Vec3& origin, const Vec3& direction) {
+	double best = 1e300, t;
+	for (size_t i = 0; i < tris.size(); i += 3) {
+		if (rayTriangle(origin, direction, v[tris[i]], v[tris[i + 1]], v[tris[i + 2]], t)) best = std::min(best, t);
+	}
+	return best;
+}
+
+static void testMeshClosestPoint() {
+	std::vector<Vec3> v;
+	std::vector<int> tris;
+	makeSoup(3000, 0.03, 1, v, tris);
+	MeshBVH bvh;
+	bvh.build(v, tris);
+	CHECK(bvh.triangleCount() == 3000);
+
+	std::mt19937 random(2);
+	std::uniform_real_distribution<double> around(-0.5, 1.5);
+	int hint = -1;
+	for (int q = 0; q < 500; q++) {
+		Vec3 p(around(random), around(random), around(random));
+		double expected = bruteDistance(v, tris, p);
+		ClosestHit hit;
+		CHECK(bvh.closestPoint(p, hit));
+		CHECK_NEAR(hit.distance, expected, 1e-9);
+		CHECK_NEAR(length(hit.point - p), expected, 1e-9);
+		CHECK(hit.triangle >= 0 && hit.triangle < bvh.triangleCount());
+
+		//hinted queries give the same answer from any starting triangle
+		ClosestHit near;
+		CHECK(bvh.closestPointNear(p, hint, near));
+		CHECK_NEAR(near.distance, expected, 1e-9);
+		hint = hit.triangle;
+
+		//a search radius only finds what lies inside it
+		ClosestHit bounded;
+		CHECK(bvh.closestPoint(p, bounded, expected * 1.01 + 1e-12));
+		CHECK(!bvh.closestPoint(p, bounded, expected * 0.99));
+	}
+}
+
+static void testMeshRaycast() {
+	std::vector<Vec3> v;
+	std::vector<int> tris;
+	makeSoup(4000, 0.05, 3, v, tris);
+	MeshBVH bvh;
+	bvh.build(v, tris);
+
+	std::mt19937 random(4);
+	std::uniform_real_distribution<double> unit(0, 1);
+	int hits = 0;
+	for (int q = 0; q < 1000; q++) {
+		Vec3 origin(unit(random), unit(random), unit(random));
+		Vec3 direction = randomDirection(random) * (0.5 + unit(random));
+		double expected = bruteRay(v, tris, origin, direction);
+		RayHit hit;
+		bool found = bvh.raycast(origin, direction, hit);
+		CHECK(found == (expected < 1e300));
+		CHECK(bvh.intersects(origin, direction) == found);
+		if (!found) continue;
+		hits++;
+		CHECK_NEAR(hit.t, expected, 1e-9 * (1 + expected));
+		RayHit limited;
+		CHECK(!bvh.raycast(origin, direction, limited, expected * 0.99));
+	}
+	//the soup is dense enough that most rays hit something
+	CHECK(hits > 500);
+}
+
+static void testMeshSignedDistance() {
+	std::vector<Vec3> v;
+	std::vector<int> tris;
+	makeSphere(1.0, 32, 64, v, tris);
+	MeshBVH bvh;
+	bvh.build(v, tris);
+
+	std::mt19937 random(5);
+	std::uniform_real_distribution<double> radius(0, 2);
+	for (int q = 0; q < 1000; q++) {
+		Vec3 p = randomDirection(random) * radius(random);
+		double expected = bruteDistance(v, tris, p);
+		ClosestHit hit;
+		double d = bvh.signedDistance(p, &hit);
+		CHECK_NEAR(std::fabs(d), expected, 1e-9);
+		//the tessellation is within 0.005 of the true sphere, so away from it the sign is known
+		if (std::fabs(length(p) - 1) > 0.02) CHECK((d < 0) == (length(p) < 1));
+	}
+	//points right on a vertex or an edge still get an outward normal
+	for (int i = 0; i < (int)v.size(); i += 37) {
+		Vec3 outside = v[i] * 1.001, inside = v[i] * 0.999;
+		CHECK(bvh.signedDistance(outside) > 0);
+		CHECK(bvh.signedDistance(inside) < 0);
+	}
+}
+
+//Instances of two shared meshes, rotated, scaled and moved apart
+static void testScene() {
+	std::vector<Vec3> sphereVerts, soupVerts;
+	std::vector<int> sphereTris, soupTris;
+	makeSphere(1.0, 12, 24, sphereVerts, sphereTris);
+	makeSoup(500, 0.1, 6, soupVerts, soupTris);
+	std::shared_ptr<MeshBVH> sphere(new MeshBVH), soup(new MeshBVH);
+	sphere->build(sphereVerts, sphereTris);
+	soup->build(soupVerts, soupTris);
+
+	SceneBVH scene;
+	std::vector<const std::vector<Vec3>*> instanceVerts;
+	std::vector<const std::vector<int>*> instanceTris;
+	std::vector<Similarity> placements;
+	std::vector<bool> isSphere;
+	std::mt19937 random(7);
+	std::uniform_real_distribution<double> unit(0, 1);
+	for (int i = 0; i < 20; i++) {
+		//rows of a random rotation, scaled, then the translation (Maya's row vector layout)
+		Vec3 x = randomDirection(random);
+		Vec3 y = normalize(cross(x, randomDirection(random)));
+		Vec3 z = cross(x, y);
+		double s = 0.3 + unit(random);
+		double m[4][4] = {
+			{ x.x * s, x.y * s, x.z * s, 0 },
+			{ y.x * s, y.y * s, y.z * s, 0 },
+			{ z.x * s, z.y * s, z.z * s, 0 },
+			{ (i % 5) * 4.0, (i / 5) * 4.0, unit(random), 1 } };
+		Similarity placement;
+		CHECK(Similarity::fromMatrix(m, placement));
+		bool round = i % 3 != 0;
+		int id = scene.addMesh(round ? sphere : soup, placement);
+		CHECK(id == i);
+		instanceVerts.push_back(round ? &sphereVerts : &soupVerts);
+		instanceTris.push_back(round ? &sphereTris : &soupTris);
+		placements.push_back(placement);
+		isSphere.push_back(round);
+	}
+	scene.build();
+	CHECK(scene.meshCount() == 20);
+
+	//every instance's triangles in world space, for the brute force answers
+	std::vector<std::vector<Vec3> > worldVerts(20);
+	for (int i = 0; i < 20; i++) {
+		for (size_t k = 0; k < instanceVerts[i]->size(); k++) worldVerts[i].push_back(placements[i].toWorld((*instanceVerts[i])[k]));
+	}
+
+	std::uniform_real_distribution<double> spanX(-2, 18), spanY(-2, 14), spanZ(-2, 3);
+	for (int q = 0; q < 400; q++) {
+		Vec3 p(spanX(random), spanY(random), spanZ(random));
+		double expected = 1e300;
+		int nearestMesh = -1;
+		for (int i = 0; i < 20; i++) {
+			double d = bruteDistance(worldVerts[i], *instanceTris[i], p);
+			if (d < expected) { expected = d; nearestMesh = i; }
+		}
+		SceneHit hit;
+		CHECK(scene.closestPoint(p, hit));
+		CHECK_NEAR(hit.hit.distance, expected, 1e-9);
+		CHECK_NEAR(length(hit.hit.point - p), expected, 1e-9);
+		CHECK(hit.mesh >= 0);
+
+		SceneHit near;
+		CHECK(scene.closestPointNear(p, q % 2 ? scene.sceneTriangle(hit) : -1, near));
+		CHECK_NEAR(near.hit.distance, expected, 1e-9);
+
+		//inside a sphere instance is negative; the soup is open, so only spheres are checked
+		if (isSphere[nearestMesh]) {
+			Vec3 local = placements[nearestMesh].toObject(p);
+			if (std::fabs(length(local) - 1) > 0.05) CHECK((scene.signedDistance(p) < 0) == (length(local) < 1));
+		}
+
+		Vec3 direction = randomDirection(random);
+		double expectedT = 1e300;
+		for (int i = 0; i < 20; i++) expectedT = std::min(expectedT, bruteRay(worldVerts[i], *instanceTris[i], p, direction));
+		SceneRayHit ray;
+		bool found = scene.raycast(p, direction, ray);
+		CHECK(found == (expectedT < 1e300));
+		CHECK(scene.intersects(p, direction) == found);
+		if (found) CHECK_NEAR(ray.hit.t, expectedT, 1e-9 * (1 + expectedT));
+	}
+
+	//scene triangles number every instance's triangles once
+	int total = 0;
+	for (int i = 0; i < 20; i++) total += (int)instanceTris[i]->size() / 3;
+	CHECK(scene.triangleCount() == total);
+}
+
+static void testSparseSDF() {
+	std::vector<Vec3> v;
+	std::vector<int> tris;
+	makeSphere(1.0, 24, 48, v, tris);
+	std::shared_ptr<MeshBVH> sphere(new MeshBVH);
+	sphere->build(v, tris);
+	SceneBVH scene;
+	scene.addMesh(sphere, Similarity());
+	scene.build();
+
+	ThreadPool pool(4);
+	SparseSDF sdf;
+	const double voxel = 0.02, band = 0.1;
+	sdf.build(scene, voxel, band, pool);
+	CHECK(!sdf.empty());
+
+	std::mt19937 random(8);
+	std::uniform_real_distribution<double> radius(0.8, 1.2);
+	int inBand = 0;
+	for (int q = 0; q < 5000; q++) {
+		Vec3 p = randomDirection(random) * radius(random);
+		double exact = scene.signedDistance(p);
+		double sampled;
+		Vec3 gradient;
+		bool found = sdf.sample(p, sampled, &gradient);
+		//everything within the band of a triangle is covered
+		if (std::fabs(exact) < band) CHECK(found);
+		if (!found) continue;
+		inBand++;
+		//trilinear over samples stored as floats
+		CHECK_NEAR(sampled, exact, 0.25 * voxel);
+		//the distance field's gradient is a unit normal, away from the mesh's edges at least
+		if (std::fabs(exact) > 2 * voxel) CHECK_NEAR(length(gradient), 1, 0.1);
+	}
+	CHECK(inBand > 1000);
+}
+
+int main() {
+	testMeshClosestPoint();
+	testMeshRaycast();
+	testMeshSignedDistance();
+	testScene();
+	testSparseSDF();
+	return finish("testGeometry");
+}
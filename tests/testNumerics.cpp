@@ -0,0 +1,153 @@
+//BandedMatrix against dense elimination, and fitCubic's error bound measured on the curve itself
+#include "testing.h"
+#include "bandedMatrix.h"
+#include "curveFit.h"
+
+//Gaussian elimination with partial pivoting on a full copy
+static std::vector<double> denseSolve(std::vector<std::vector<double> > a, std::vector<double> b) {
+	int n = (int)b.size();
+	for (int c = 0; c < n; c++) {
+		int pivot = c;
+		for (int r = c + 1; r < n; r++) if (std::fabs(a[r][c]) > std::fabs(a[pivot][c])) pivot = r;
+		std::swap(a[c], a[pivot]);
+		std::swap(b[c], b[pivot]);
+		for (int r = c + 1; r < n; r++) {
+			double f = a[r][c] / a[c][c];
+			for (int k = c; k < n; k++) a[r][k] -= f * a[c][k];
+			b[r] -= f * b[c];
+		}
+	}
+	std::vector<double> x(n);
+	for (int r = n - 1; r >= 0; r--) {
+		double s = b[r];
+		for (int k = r + 1; k < n; k++) s -= a[r][k] * x[k];
+		x[r] = s / a[r][r];
+	}
+	return x;
+}
+
+static void testBandedMatrix() {
+	std::mt19937 random(11);
+	std::uniform_real_distribution<double> value(-1, 1);
+	int sizes[] = { 1, 2, 5, 40, 200 };
+	int bandwidths[] = { 0, 1, 2, 3 };
+	for (int n : sizes) {
+		for (int k : bandwidths) {
+			//diagonally dominant, so symmetric positive definite
+			BandedMatrix banded(n, k);
+			banded.setZero();
+			std::vector<std::vector<double> > dense(n, std::vector<double>(n, 0.0));
+			for (int i = 0; i < n; i++) {
+				for (int j = std::max(0, i - k); j < i; j++) {
+					double v = value(random);
+					banded.at(i, j) = v;
+					dense[i][j] = dense[j][i] = v;
+				}
+			}
+			for (int i = 0; i < n; i++) {
+				double sum = 1;
+				for (int j = 0; j < n; j++) if (j != i) sum += std::fabs(dense[i][j]);
+				banded.at(i, i) = dense[i][i] = sum + std::fabs(value(random));
+			}
+			std::vector<double> rhs(n);
+			for (int i = 0; i < n; i++) rhs[i] = value(random);
+			std::vector<double> expected = denseSolve(dense, rhs);
+			CHECK(banded.solve(rhs));
+			for (int i = 0; i < n; i++) CHECK_NEAR(rhs[i], expected[i], 1e-10);
+		}
+	}
+
+	//not positive definite
+	BandedMatrix indefinite(3, 1);
+	indefinite.setZero();
+	indefinite.at(0, 0) = 1;
+	indefinite.at(1, 1) = -2;
+	indefinite.at(2, 2) = 1;
+	std::vector<double> rhs(3, 1.0);
+	CHECK(!indefinite.solve(rhs));
+}
+
+//Point on the clamped B-spline, de Boor over the knots with Maya's missing end knots put back
+static Vec3 evaluateFit(const CurveFit& fit, double u) {
+	std::vector<double> U;
+	U.push_back(fit.knots.front());
+	U.insert(U.end(), fit.knots.begin(), fit.knots.end());
+	U.push_back(fit.knots.back());
+	int p = fit.degree, m = (int)fit.cvs.size();
+	int s = p;
+	while (s < m - 1 && u >= U[s + 1]) s++;
+	std::vector<Vec3> d(fit.cvs.begin() + (s - p), fit.cvs.begin() + s + 1);
+	for (int r = 1; r <= p; r++) {
+		for (int j = p; j >= r; j--) {
+			int i = s - p + j;
+			double span = U[i + p - r + 1] - U[i];
+			double a = span > 0 ? (u - U[i]) / span : 0;
+			d[j] = d[j - 1] * (1 - a) + d[j] * a;
+		}
+	}
+	return d[p];
+}
+
+static double distanceToSegment(const Vec3& p, const Vec3& a, const Vec3& b) {
+	Vec3 ab = b - a;
+	double l2 = length2(ab);
+	double f = l2 > 0 ? std::min(1.0, std::max(0.0, dot(p - a, ab) / l2)) : 0;
+	return length(a + ab * f - p);
+}
+
+static void checkFit(const std::vector<Vec3>& points, double tolerance) {
+	CurveFit fit;
+	fitCubic(points, tolerance, fit);
+	CHECK(fit.degree == 3);
+	CHECK(fit.knots.size() == fit.cvs.size() + fit.degree - 1);
+	CHECK(fit.cvs.size() < points.size());
+	CHECK(fit.maxError <= tolerance);
+	CHECK_NEAR(length(fit.cvs.front() - points.front()), 0, 1e-9);
+	CHECK_NEAR(length(fit.cvs.back() - points.back()), 0, 1e-9);
+
+	//every input point is within the reported error of the curve, measured on a dense polyline
+	std::vector<Vec3> curve;
+	const int samples = 4000;
+	for (int i = 0; i <= samples; i++) {
+		double u = fit.knots.front() + (fit.knots.back() - fit.knots.front()) * i / samples;
+		curve.push_back(evaluateFit(fit, u));
+	}
+	double worst = 0;
+	for (size_t i = 0; i < points.size(); i++) {
+		double best = 1e300;
+		for (int k = 0; k < samples; k++) best = std::min(best, distanceToSegment(points[i], curve[k], curve[k + 1]));
+		worst = std::max(worst, best);
+	}
+	CHECK(worst <= fit.maxError + 1e-6);
+}
+
+static void testCurveFit() {
+	//a helix sampled densely, a sharp hairpin and a noisy line
+	std::vector<Vec3> helix, hairpin, noisy;
+	for (int i = 0; i < 300; i++) {
+		double a = i * 0.05;
+		helix.push_back(Vec3(std::cos(a), std::sin(a), a * 0.1));
+	}
+	for (int i = 0; i < 100; i++) hairpin.push_back(Vec3(i * 0.01, 0, 0));
+	for (int i = 0; i < 100; i++) hairpin.push_back(Vec3(1 - i * 0.01, 0.02, 0));
+	std::mt19937 random(12);
+	std::uniform_real_distribution<double> jitter(-0.001, 0.001);
+	for (int i = 0; i < 200; i++) noisy.push_back(Vec3(i * 0.01, jitter(random), jitter(random)));
+
+	checkFit(helix, 1e-3);
+	checkFit(hairpin, 1e-3);
+	checkFit(noisy, 5e-3);
+
+	//fewer than 4 points come back as the polyline itself
+	std::vector<Vec3> three(helix.begin(), helix.begin() + 3);
+	CurveFit fit;
+	fitCubic(three, 1e-3, fit);
+	CHECK(fit.degree == 1);
+	CHECK(fit.cvs.size() == 3);
+}
+
+int main() {
+	testBandedMatrix();
+	testCurveFit();
+	return finish("testNumerics");
+}
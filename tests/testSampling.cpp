@@ -0,0 +1,180 @@
+//StrokeSampler's spacing, deviation and budget, FurScatter's minimum spacing and density, and
+//ThreadPool loops that race a change of thread count
+#include "testing.h"
+#include "strokeSampler.h"
+#include "furScatter.h"
+#include "threadPool.h"
+#include <atomic>
+#include <thread>
+
+struct Pen { double x, y; };
+
+//Feeds the positions in slowly (so the speed allowance stays negligible) and returns the kept
+//ones' indices; the release is kept as index positions.size() when the sampler takes it
+static std::vector<int> draw(StrokeSampler& sampler, const std::vector<Pen>& positions) {
+	std::vector<int> kept(1, 0);
+	sampler.begin(positions[0].x, positions[0].y, 0);
+	for (size_t i = 1; i < positions.size(); i++) {
+		if (sampler.accept(positions[i].x, positions[i].y, 10.0 * i)) kept.push_back((int)i);
+	}
+	const Pen& last = positions.back();
+	if (sampler.end(last.x, last.y)) kept.push_back((int)positions.size());
+	return kept;
+}
+
+static double segmentDeviation(const Pen& p, const Pen& a, const Pen& b) {
+	double cx = b.x - a.x, cy = b.y - a.y, px = p.x - a.x, py = p.y - a.y;
+	double c2 = cx * cx + cy * cy;
+	double along = c2 > 0 ? std::min(1.0, std::max(0.0, (px * cx + py * cy) / c2)) : 0;
+	return std::hypot(px - along * cx, py - along * cy);
+}
+
+static void testSampler() {
+	std::vector<Pen> spiral;
+	for (int i = 0; i < 3000; i++) {
+		double a = i * 0.01;
+		spiral.push_back(Pen{ a * 20 * std::cos(a), a * 20 * std::sin(a) });
+	}
+
+	StrokeSampler sampler;
+	sampler.setSpacing(2, 40);
+	sampler.setTolerance(0.5);
+	std::vector<int> kept = draw(sampler, spiral);
+	CHECK(kept.size() > 20);
+	for (size_t k = 1; k < kept.size(); k++) {
+		const Pen& a = spiral[kept[k - 1]];
+		const Pen& b = spiral[std::min(kept[k], (int)spiral.size() - 1)];
+		double chord = std::hypot(b.x - a.x, b.y - a.y);
+		CHECK(chord >= 2);
+		//kept as soon as the chord passes the maximum, so within one pen step of it
+		const Pen& before = spiral[std::min(kept[k], (int)spiral.size() - 1) - 1];
+		CHECK(chord <= 40 + std::hypot(b.x - before.x, b.y - before.y));
+		//a position is kept once the one before it no longer fits: everything skipped up to
+		//that one lies within the tolerance of the chord to it
+		int previous = std::min(kept[k], (int)spiral.size()) - 1;
+		if (previous <= kept[k - 1]) continue;
+		const Pen& end = spiral[previous];
+		if (std::hypot(end.x - a.x, end.y - a.y) < 2) continue;
+		for (int i = kept[k - 1] + 1; i < previous; i++) CHECK(segmentDeviation(spiral[i], a, end) <= 0.5 * 1.01);
+	}
+
+	//a hairpin's tip is kept even though the stroke doubles back along the same line
+	std::vector<Pen> hairpin;
+	for (int i = 0; i <= 200; i++) hairpin.push_back(Pen{ (double)i, 0 });
+	for (int i = 199; i >= 0; i--) hairpin.push_back(Pen{ (double)i, 0.3 });
+	sampler.setSpacing(2, 1000);
+	kept = draw(sampler, hairpin);
+	bool tip = false;
+	for (size_t k = 0; k < kept.size(); k++) {
+		if (kept[k] < (int)hairpin.size() && hairpin[kept[k]].x >= 195) tip = true;
+	}
+	CHECK(tip);
+
+	//a budget holds the whole stroke, release included
+	int budgets[] = { 1, 2, 10, 50 };
+	for (int budget : budgets) {
+		StrokeSampler limited;
+		limited.setSpacing(2, 40);
+		limited.setTolerance(0.5);
+		limited.setBudget(budget);
+		kept = draw(limited, spiral);
+		CHECK((int)kept.size() <= budget);
+		if (budget >= 2) CHECK(kept.back() == (int)spiral.size());
+		if (budget >= 10) CHECK((int)kept.size() >= budget / 2);
+	}
+
+	//a release on the last kept position adds nothing
+	StrokeSampler still;
+	still.begin(5, 5, 0);
+	CHECK(!still.end(5, 5));
+	CHECK(still.end(50, 5));
+	CHECK(!still.end(50, 5));
+}
+
+//Smallest distance between any two roots, the slow way
+static double closestPair(const std::vector<Vec3>& roots) {
+	double best = 1e300;
+	for (size_t a = 0; a < roots.size(); a++)
+		for (size_t b = a + 1; b < roots.size(); b++) best = std::min(best, length2(roots[a] - roots[b]));
+	return std::sqrt(best);
+}
+
+static void testScatter() {
+	ThreadPool pool(4);
+	std::vector<Vec3> v;
+	std::vector<int> tris;
+	makeSphere(1.0, 64, 128, v, tris);
+
+	FurScatter scatter;
+	scatter.addTriangles(v, tris, std::vector<float>(), std::vector<char>());
+	CHECK(scatter.triangleCount() == (int)tris.size() / 3);
+	int placed = scatter.scatter(3000, 0.03, pool);
+	CHECK(placed == (int)scatter.roots().size());
+	CHECK(placed > 2500 && placed <= 3000);
+	CHECK(closestPair(scatter.roots()) >= 0.03);
+	CHECK(scatter.normals().size() == scatter.roots().size());
+	for (size_t i = 0; i < scatter.roots().size(); i++) {
+		//on the tessellated sphere, which is within 0.001 of the round one
+		CHECK_NEAR(length(scatter.roots()[i]), 1, 2e-3);
+		CHECK(dot(scatter.normals()[i], scatter.roots()[i]) > 0.99);
+	}
+
+	//a spacing picked from the count is honoured as well
+	placed = scatter.scatter(2000, 0, pool);
+	CHECK(scatter.spacingUsed() > 0);
+	CHECK(placed > 1000 && placed <= 2000);
+	CHECK(closestPair(scatter.roots()) >= scatter.spacingUsed());
+
+	//a unit square whose map is black on the left half and white on the right, next to an
+	//unmapped square that must stay at full density
+	std::vector<Vec3> square = { Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(1, 1, 0), Vec3(0, 1, 0), Vec3(2, 0, 0), Vec3(2, 1, 0) };
+	std::vector<int> quads = { 0, 1, 2, 0, 2, 3, 1, 4, 5, 1, 5, 2 };
+	std::vector<float> uvs = { 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+	std::vector<char> mapped = { 1, 1, 0, 0 };
+	std::vector<float> map(64 * 4);
+	for (int j = 0; j < 4; j++)
+		for (int i = 0; i < 64; i++) map[j * 64 + i] = i < 32 ? 0.0f : 1.0f;
+	FurScatter painted;
+	painted.setDensityMap(64, 4, map);
+	painted.addTriangles(square, quads, uvs, mapped);
+	painted.scatter(100000, 0.02, pool);
+	int dark = 0, light = 0, unmapped = 0;
+	for (size_t i = 0; i < painted.roots().size(); i++) {
+		double x = painted.roots()[i].x;
+		//the map wraps like a texture, so its first and last columns blend at the left edge
+		if (x > 0.02 && x < 0.45) dark++;
+		else if (x > 0.55 && x < 0.95) light++;
+		else if (x > 1.05) unmapped++;
+	}
+	CHECK(dark == 0);
+	CHECK(light > 500);
+	CHECK(unmapped > 1000);
+	CHECK(closestPair(painted.roots()) >= 0.02);
+}
+
+//Loops from a second thread keep running while the first changes the thread count; every item
+//of every loop has to run exactly once, and no loop may return before its items are done
+static void testThreadPoolRestart() {
+	ThreadPool pool(4);
+	std::atomic<bool> stop(false);
+	std::atomic<int> wrong(0);
+	std::thread solver([&]() {
+		std::vector<std::atomic<int> > counts(500);
+		while (!stop) {
+			for (size_t i = 0; i < counts.size(); i++) counts[i] = 0;
+			pool.parallelFor((int)counts.size(), [&](int i) { counts[i]++; }, 7);
+			for (size_t i = 0; i < counts.size(); i++) if (counts[i] != 1) wrong++;
+		}
+	});
+	for (int k = 0; k < 300; k++) pool.setThreadCount(1 + k % 6);
+	stop = true;
+	solver.join();
+	CHECK(wrong == 0);
+}
+
+int main() {
+	testSampler();
+	testScatter();
+	testThreadPoolRestart();
+	return finish("testSampling");
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "vec3.h"
+
+//Checks for the Maya-free code: a failed CHECK prints where it failed and carries on, and each
+//test program returns how many failed, so ctest reports the file
+inline int& failureCount() {
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			failureCount()++; \
+		} \
+	} while (0)
+
+//a and b within tolerance of each other
+#define CHECK_NEAR(a, b, tolerance) \
+	do { \
+		double checkA = (a), checkB = (b); \
+		if (!(std::fabs(checkA - checkB) <= (tolerance))) { \
+			std::printf("%s:%d: check failed: %s = %.12g, %s = %.12g\n", __FILE__, __LINE__, #a, checkA, #b, checkB); \
+			failureCount()++; \
+		} \
+	} while (0)
+
+inline int finish(const char* name) {
+	std::printf("%s: %s (%d failed)\n", name, failureCount() ? "FAILED" : "passed", failureCount());
+	return failureCount() ? 1 : 0;
+}
+
+//Closed latitude-longitude sphere, every triangle wound so its normal points out
+inline void makeSphere(double radius, int rings, int segments, std::vector<Vec3>& vertices, std::vector<int>& triangles) {
+	const double pi = 3.14159265358979323846;
+	vertices.clear();
+	triangles.clear();
+	vertices.push_back(Vec3(0, 0, radius));
+	for (int i = 1; i < rings; i++) {
+		double theta = pi * i / rings;
+		for (int j = 0; j < segments; j++) {
+			double phi = 2 * pi * j / segments;
+			vertices.push_back(Vec3(radius * std::sin(theta) * std::cos(phi), radius * std::sin(theta) * std::sin(phi),
+				radius * std::cos(theta)));
+		}
+	}
+	vertices.push_back(Vec3(0, 0, -radius));
+	int bottom = (int)vertices.size() - 1;
+	for (int i = 0; i < rings; i++) {
+		for (int j = 0; j < segments; j++) {
+			int k = (j + 1) % segments;
+			int a = i == 0 ? 0 : 1 + (i - 1) * segments + j;
+			int b = i == 0 ? 0 : 1 + (i - 1) * segments + k;
+			int c = i == rings - 1 ? bottom : 1 + i * segments + j;
+			int d = i == rings - 1 ? bottom : 1 + i * segments + k;
+			if (i > 0) { triangles.push_back(a); triangles.push_back(b); triangles.push_back(c); }
+			if (i < rings - 1) { triangles.push_back(b); triangles.push_back(d); triangles.push_back(c); }
+		}
+	}
+	for (size_t t = 0; t < triangles.size(); t += 3) {
+		const Vec3& a = vertices[triangles[t]];
+		const Vec3& b = vertices[triangles[t + 1]];
+		const Vec3& c = vertices[triangles[t + 2]];
+		if (dot(cross(b - a, c - a), a + b + c) < 0) std::swap(triangles[t + 1], triangles[t + 2]);
+	}
+}
+
+//count unconnected triangles scattered through the unit cube, none wider than size
+inline void makeSoup(int count, double size, unsigned seed, std::vector<Vec3>& vertices, std::vector<int>& triangles) {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> unit(0, 1), offset(-size, size);
+	vertices.clear();
+	triangles.clear();
+	for (int t = 0; t < count; t++) {
+		Vec3 centre(unit(random), unit(random), unit(random));
+		for (int k = 0; k < 3; k++) {
+			triangles.push_back((int)vertices.size());
+			vertices.push_back(centre + Vec3(offset(random), offset(random), offset(random)));
+		}
+	}
+}
+
+//Ray against one triangle (Moller-Trumbore); t along direction, which needn't be unit length
+inline bool rayTriangle(const Vec3& origin, const Vec3& direction, const Vec3& a, const Vec3& b, const Vec3& c, double& t) {
+	Vec3 e1 = b - a, e2 = c - a;
+	Vec3 p = cross(direction, e2);
+	double det = dot(e1, p);
+	if (std::fabs(det) < 1e-300) return false;
+	double inv = 1 / det;
+	Vec3 s = origin - a;
+	double u = dot(s, p) * inv;
+	if (u < 0 || u > 1) return false;
+	Vec3 q = cross(s, e1);
+	double v = dot(direction, q) * inv;
+	if (v < 0 || u + v > 1) return false;
+	t = dot(e2, q) * inv;
+	return t >= 0;
+}
+
+inline Vec3 randomDirection(std::mt19937& random) {
+	std::normal_distribution<double> normal;
+	Vec3 d;
+	do d = Vec3(normal(random), normal(random), normal(random)); while (length2(d) < 1e-12);
+	return normalize(d);
+}
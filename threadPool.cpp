@@ -0,0 +1,93 @@
+#include "threadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) : quitting(false), generation(0), busy(0),
+	job(0), jobCount(0), jobGrain(1), next(0)
+{
+	start(threadCount);
+}
+
+ThreadPool::~ThreadPool() {
+	stop();
+}
+
+void ThreadPool::setThreadCount(int threadCount) {
+	int wanted = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	if (std::max(1, wanted) == this->threadCount()) return;
+	std::unique_lock<std::mutex> turn(running);
+	stop();
+	start(threadCount);
+}
+
+void ThreadPool::start(int threadCount) {
+	if (threadCount <= 0) threadCount = (int)std::thread::hardware_concurrency();
+	unsigned long long current;
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		quitting = false;
+		current = generation;
+	}
+	//workers start level with the loops already run, so they only wake for the next one
+	for (int i = 1; i < threadCount; i++) workers.push_back(std::thread(&ThreadPool::workerLoop, this, current));
+}
+
+void ThreadPool::stop() {
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		quitting = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+	workers.clear();
+}
+
+void ThreadPool::runChunks() {
+	while (true) {
+		int begin = next.fetch_add(jobGrain);
+		if (begin >= jobCount) return;
+		int end = std::min(jobCount, begin + jobGrain);
+		for (int i = begin; i < end; i++) (*job)(i);
+	}
+}
+
+//seen is the last loop this worker took part in
+void ThreadPool::workerLoop(unsigned long long seen) {
+	while (true) {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [&]() { return quitting || generation != seen; });
+			if (quitting) return;
+			seen = generation;
+		}
+		runChunks();
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			if (--busy == 0) done.notify_all();
+		}
+	}
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& fn, int grain) {
+	if (count <= 0) return;
+	std::unique_lock<std::mutex> turn(running);
+	if (workers.empty() || count <= grain) {
+		for (int i = 0; i < count; i++) fn(i);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		job = &fn;
+		jobCount = count;
+		jobGrain = std::max(1, grain);
+		next = 0;
+		busy = (int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+	runChunks();
+
+	std::unique_lock<std::mutex> guard(lock);
+	done.wait(guard, [&]() { return busy == 0; });
+	job = 0;
+}
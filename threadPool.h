@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+//Fixed set of worker threads for data parallel loops over independent items.
+//The calling thread joins in, so a pool of one thread runs everything inline.
+class ThreadPool {
+public:
+	//threadCount <= 0 uses every hardware thread
+	explicit ThreadPool(int threadCount = 0);
+	~ThreadPool();
+
+	void setThreadCount(int threadCount);
+	int threadCount() const { return (int)workers.size() + 1; }
+
+	//calls fn(i) for every i in [0, count), grain items at a time, and returns when all are done.
+	//Must not be called again from inside fn. Loops started from different threads take turns.
+	void parallelFor(int count, const std::function<void(int)>& fn, int grain = 1);
+
+private:
+	void start(int threadCount);
+	void stop();
+	void workerLoop(unsigned long long seen);
+	void runChunks();
+
+	std::vector<std::thread> workers;
+	std::mutex running; //held for a whole loop, and while the workers are replaced
+	std::mutex lock;
+	std::condition_variable wake, done;
+	bool quitting;
+	unsigned long long generation;
+	int busy;
+
+	//the loop currently being run
+	const std::function<void(int)>* job;
+	int jobCount, jobGrain;
+	std::atomic<int> next;
+};
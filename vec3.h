@@ -0,0 +1,79 @@
+#pragma once
+#include <cmath>
+
+//Plain 3d vector used by the Maya-free geometry code (BVH, distance fields, fitting)
+struct Vec3 {
+	double x, y, z;
+
+	Vec3() : x(0), y(0), z(0) {}
+	Vec3(double a, double b, double c) : x(a), y(b), z(c) {}
+
+	double operator[](int i) const { return (&x)[i]; }
+	double& operator[](int i) { return (&x)[i]; }
+
+	Vec3 operator+(const Vec3& o) const { return Vec3(x + o.x, y + o.y, z + o.z); }
+	Vec3 operator-(const Vec3& o) const { return Vec3(x - o.x, y - o.y, z - o.z); }
+	Vec3 operator-() const { return Vec3(-x, -y, -z); }
+	Vec3 operator*(double s) const { return Vec3(x * s, y * s, z * s); }
+	Vec3 operator/(double s) const { return Vec3(x / s, y / s, z / s); }
+	Vec3& operator+=(const Vec3& o) { x += o.x; y += o.y; z += o.z; return *this; }
+	Vec3& operator-=(const Vec3& o) { x -= o.x; y -= o.y; z -= o.z; return *this; }
+	Vec3& operator*=(double s) { x *= s; y *= s; z *= s; return *this; }
+};
+
+inline Vec3 operator*(double s, const Vec3& v) { return v * s; }
+inline double dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 cross(const Vec3& a, const Vec3& b) {
+	return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline double length2(const Vec3& v) { return dot(v, v); }
+inline double length(const Vec3& v) { return std::sqrt(dot(v, v)); }
+inline Vec3 normalize(const Vec3& v) {
+	double l = length(v);
+	return l > 0 ? v / l : v;
+}
+inline Vec3 vmin(const Vec3& a, const Vec3& b) {
+	return Vec3(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z);
+}
+inline Vec3 vmax(const Vec3& a, const Vec3& b) {
+	return Vec3(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z);
+}
+
+//Axis aligned box, empty until something is added
+struct Box {
+	Vec3 lo, hi;
+
+	Box() : lo(1e300, 1e300, 1e300), hi(-1e300, -1e300, -1e300) {}
+	Box(const Vec3& a, const Vec3& b) : lo(a), hi(b) {}
+
+	bool empty() const { return lo.x > hi.x; }
+	void add(const Vec3& p) { lo = vmin(lo, p); hi = vmax(hi, p); }
+	void add(const Box& b) { lo = vmin(lo, b.lo); hi = vmax(hi, b.hi); }
+	Vec3 center() const { return (lo + hi) * 0.5; }
+	Vec3 extent() const { return hi - lo; }
+	double area() const {
+		Vec3 e = hi - lo;
+		return empty() ? 0 : 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+	//squared distance from p to the box, 0 inside
+	double distance2(const Vec3& p) const {
+		double d = 0, v;
+		for (int i = 0; i < 3; i++) {
+			if (p[i] < lo[i]) { v = lo[i] - p[i]; d += v * v; }
+			else if (p[i] > hi[i]) { v = p[i] - hi[i]; d += v * v; }
+		}
+		return d;
+	}
+	//slab test; tNear/tFar are clipped to the given range
+	bool intersect(const Vec3& o, const Vec3& invDir, double& tNear, double& tFar) const {
+		for (int i = 0; i < 3; i++) {
+			double t0 = (lo[i] - o[i]) * invDir[i];
+			double t1 = (hi[i] - o[i]) * invDir[i];
+			if (t0 > t1) { double tmp = t0; t0 = t1; t1 = tmp; }
+			if (t0 > tNear) tNear = t0;
+			if (t1 < tFar) tFar = t1;
+			if (tNear > tFar) return false;
+		}
+		return true;
+	}
+};